@@ -9,6 +9,17 @@
 #include <stdexcept>
 #include <cmath>
 #include <array>
+#include <algorithm>
+
+// Conservative bounds of a bundle of rays that all share the same direction octant.
+// Every ray in the bundle has its origin inside [origin_min, origin_max] and its
+// inverse direction inside [inv_direction_min, inv_direction_max].
+struct RayInterval {
+  glm::vec3 origin_min{};
+  glm::vec3 origin_max{};
+  glm::vec3 inv_direction_min{};
+  glm::vec3 inv_direction_max{};
+};
 
 class Aabb {
 public:
@@ -73,6 +84,53 @@ public:
     return true;
   }
 
+  // Same as above, for rays whose inverse direction was already computed
+  auto hit(const glm::vec3& origin, const glm::vec3& inv_direction, float min_distance, float max_distance) const -> bool {
+    for (auto axis_index = 0u; axis_index < 3u; ++axis_index) {
+      auto axis = m_axes[axis_index];
+      auto indexi = static_cast<int>(axis_index);
+      auto t0 = (axis.min - origin[indexi]) * inv_direction[indexi];
+      auto t1 = (axis.max - origin[indexi]) * inv_direction[indexi];
+      if (inv_direction[indexi] < 0.0f) {
+        std::swap(t0, t1);
+      }
+      min_distance = t0 > min_distance ? t0 : min_distance;
+      max_distance = t1 < max_distance ? t1 : max_distance;
+      if (max_distance <= min_distance) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Returns false only if no ray of the bundle can hit the box
+  auto hit(const RayInterval& interval, float min_distance, float max_distance) const -> bool {
+    for (auto axis_index = 0u; axis_index < 3u; ++axis_index) {
+      auto axis = m_axes[axis_index];
+      auto indexi = static_cast<int>(axis_index);
+      auto inv_d_min = interval.inv_direction_min[indexi];
+      auto inv_d_max = interval.inv_direction_max[indexi];
+      auto near = inv_d_min < 0.0f ? axis.max : axis.min;
+      auto far = inv_d_min < 0.0f ? axis.min : axis.max;
+
+      auto near0 = (near - interval.origin_max[indexi]) * inv_d_min;
+      auto near1 = (near - interval.origin_max[indexi]) * inv_d_max;
+      auto near2 = (near - interval.origin_min[indexi]) * inv_d_min;
+      auto near3 = (near - interval.origin_min[indexi]) * inv_d_max;
+      auto far0 = (far - interval.origin_max[indexi]) * inv_d_min;
+      auto far1 = (far - interval.origin_max[indexi]) * inv_d_max;
+      auto far2 = (far - interval.origin_min[indexi]) * inv_d_min;
+      auto far3 = (far - interval.origin_min[indexi]) * inv_d_max;
+
+      min_distance = std::max(min_distance, std::min({near0, near1, near2, near3}));
+      max_distance = std::min(max_distance, std::max({far0, far1, far2, far3}));
+      if (max_distance < min_distance) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   auto longest_axis() const -> unsigned {
     auto extent_x = m_axes[0].max - m_axes[0].min;
     auto extent_y = m_axes[1].max - m_axes[1].min;
@@ -0,0 +1,128 @@
+#ifndef RT_ANIMATION_HPP
+#define RT_ANIMATION_HPP
+
+#include "hittable.hpp"
+#include "bvh.hpp"
+#include "renderer.hpp"
+#include "tracing.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+struct CameraKeyframe {
+  float frame{};
+  glm::vec3 look_from{};
+  glm::vec3 look_at{};
+  float fov{};
+};
+
+struct TransformKeyframe {
+  float frame{};
+  glm::vec3 offset{};
+  // rotation around the y axis, applied before the offset
+  float angle{};
+};
+
+// A hittable whose transform can change between frames. The hittable itself, and its
+// BVH, are kept: only the instance placing it in the scene is replaced.
+class Animated : public Hittable {
+public:
+  explicit Animated(std::shared_ptr<Hittable> hittable)
+    : m_hittable{hittable}
+    , m_instance{hittable}
+  {}
+
+  auto set_transform(const glm::vec3& offset, float angle) -> void {
+    m_instance = std::make_shared<Translate>(std::make_shared<RotateY>(m_hittable, angle), offset);
+  }
+
+  auto hit(const Ray& ray, float min_distance, float max_distance) const -> std::optional<HitRecord> override {
+    return m_instance->hit(ray, min_distance, max_distance);
+  }
+
+  auto bounding_box() const -> Aabb override {
+    return m_instance->bounding_box();
+  }
+
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      account.add(memory::Category::instances, sizeof(*this));
+      m_hittable->account(account);
+      m_instance->account(account);
+    }
+  }
+
+  auto add_features(SceneFeatures& features) const -> void override {
+    m_instance->add_features(features);
+  }
+
+private:
+  std::shared_ptr<Hittable> m_hittable{};
+  std::shared_ptr<Hittable> m_instance{};
+};
+
+struct ObjectTrack {
+  std::shared_ptr<Animated> object{};
+  std::vector<TransformKeyframe> keyframes{};
+};
+
+// Frames from frame_begin to frame_end excluded. The top level BVH is built again every
+// frame over instances, which should hold the animated objects and the rest of the scene
+// in a few BVHs of their own, so that a frame only rebuilds a handful of nodes.
+struct Animation {
+  unsigned frame_begin{};
+  unsigned frame_end{};
+  std::vector<CameraKeyframe> camera{};
+  std::vector<ObjectTrack> objects{};
+  Hittables instances{};
+};
+
+// Index of the last keyframe at or before frame, and how far frame is towards the next one.
+// Keyframes have to be sorted by frame.
+template <typename Keyframe>
+auto find_keyframe(const std::vector<Keyframe>& keyframes, float frame) -> std::pair<std::size_t, float> {
+  auto next = std::ranges::upper_bound(keyframes, frame, {}, &Keyframe::frame);
+  if (next == keyframes.begin()) {
+    return {0uz, 0.0f};
+  }
+  auto index = static_cast<std::size_t>(next - keyframes.begin()) - 1;
+  if (next == keyframes.end()) {
+    return {index, 0.0f};
+  }
+  return {index, (frame - keyframes[index].frame) / (next->frame - keyframes[index].frame)};
+}
+
+// Moves the camera and the objects to where they are at frame, and returns the scene to render
+auto set_frame(const Animation& animation, unsigned frame, RenderOptions& options) -> Hittables {
+  auto scope = tracing::ScopedTrace{"set_frame", frame};
+  auto time = static_cast<float>(frame);
+
+  if (!animation.camera.empty()) {
+    auto [index, t] = find_keyframe(animation.camera, time);
+    const auto& a = animation.camera[index];
+    const auto& b = animation.camera[std::min(index + 1, animation.camera.size() - 1)];
+    options.look_from = glm::mix(a.look_from, b.look_from, t);
+    options.look_at = glm::mix(a.look_at, b.look_at, t);
+    options.fov = glm::mix(a.fov, b.fov, t);
+  }
+
+  for (const auto& track : animation.objects) {
+    if (track.keyframes.empty()) {
+      continue;
+    }
+    auto [index, t] = find_keyframe(track.keyframes, time);
+    const auto& a = track.keyframes[index];
+    const auto& b = track.keyframes[std::min(index + 1, track.keyframes.size() - 1)];
+    track.object->set_transform(glm::mix(a.offset, b.offset, t), glm::mix(a.angle, b.angle, t));
+  }
+
+  auto instances = animation.instances;
+  return Hittables{std::make_shared<BvhNode>(instances)};
+}
+
+#endif
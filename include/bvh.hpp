@@ -4,14 +4,28 @@
 #include "aabb.hpp"
 #include "hittable.hpp"
 #include "random.hpp"
+#include "stats.hpp"
+#include "counters.hpp"
+
+#include <glm/geometric.hpp>
 
 #include <memory>
 #include <optional>
 #include <algorithm>
+#include <span>
+#include <limits>
 
 class BvhNode : public Hittable {
 public:
   BvhNode(Hittables& hittables, unsigned start, unsigned end) {
+    // only the whole build is timed, not each node
+    auto phase = std::optional<stats::ScopedPhase>{};
+    auto counting = std::optional<counters::Scope>{};
+    if (start == 0 && end == hittables.size()) {
+      phase.emplace(stats::Phase::bvh_build);
+      counting.emplace(counters::Section::bvh_build);
+    }
+
     auto bounding_box = hittables[start]->bounding_box();
     for (auto i = start + 1; i < end; ++i) {
       bounding_box = Aabb{bounding_box, hittables[i]->bounding_box()};
@@ -40,6 +54,14 @@ public:
       m_right = std::make_shared<BvhNode>(hittables, mid, end);
     }
 
+    auto left_box = m_left->bounding_box().axes();
+    auto right_box = m_right->bounding_box().axes();
+    m_left_to_right = glm::vec3{
+      right_box[0].min + right_box[0].max - left_box[0].min - left_box[0].max,
+      right_box[1].min + right_box[1].max - left_box[1].min - left_box[1].max,
+      right_box[2].min + right_box[2].max - left_box[2].min - left_box[2].max
+    };
+
     m_bounding_box = Aabb{m_left->bounding_box(), m_right->bounding_box()};
   }
 
@@ -62,14 +84,63 @@ public:
     return left_hit;
   }
 
+  auto hit_stream(RayStream& stream, std::span<unsigned> active) const -> void override {
+    if (stream.interval && active.size() >= s_min_interval_rays && !m_bounding_box.hit(*stream.interval, 0.0f, std::numeric_limits<float>::max())) {
+      return;
+    }
+
+    auto hit_end = std::partition(active.begin(), active.end(), [&](auto index) {
+      return m_bounding_box.hit(stream.rays[index].origin(), stream.inv_directions[index], 0.0f, stream.max_distances[index]);
+    });
+
+    auto hit_active = std::span{active.begin(), hit_end};
+    if (hit_active.empty()) {
+      return;
+    }
+
+    if (m_left == m_right) {
+      m_left->hit_stream(stream, hit_active);
+      return;
+    }
+
+    // visit the child nearest to the bundle first so that the other one is culled by closer hits
+    if (glm::dot(m_left_to_right, stream.rays[hit_active.front()].direction()) < 0.0f) {
+      m_right->hit_stream(stream, hit_active);
+      m_left->hit_stream(stream, hit_active);
+    }
+    else {
+      m_left->hit_stream(stream, hit_active);
+      m_right->hit_stream(stream, hit_active);
+    }
+  }
+
   auto bounding_box() const -> Aabb override {
     return m_bounding_box;
   }
 
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      account.add(memory::Category::bvh_nodes, sizeof(*this));
+      m_left->account(account);
+      m_right->account(account);
+    }
+  }
+
+  auto add_features(SceneFeatures& features) const -> void override {
+    m_left->add_features(features);
+    if (m_right != m_left) {
+      m_right->add_features(features);
+    }
+  }
+
 private:
+  // below this many rays, testing the bundle bounds costs more than it saves
+  static constexpr auto s_min_interval_rays = 4uz;
+
   std::shared_ptr<Hittable> m_left{};
   std::shared_ptr<Hittable> m_right{};
   Aabb m_bounding_box{};
+  glm::vec3 m_left_to_right{};
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef RT_CAMERA_HPP
+#define RT_CAMERA_HPP
+
+#include "ray.hpp"
+#include "math.hpp"
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+#include <glm/ext/scalar_constants.hpp>
+
+#include <cmath>
+
+class Camera final {
+public:
+  Camera(unsigned width, unsigned height, float fov, const glm::vec3& look_from, const glm::vec3& look_at, float focus_distance, float defocus_angle)
+    : m_look_from{look_from}
+  {
+    auto widthf = static_cast<float>(width);
+    auto heightf = static_cast<float>(height);
+    auto aspect_ratio = widthf / heightf;
+
+    auto w = glm::normalize(look_from - look_at);
+    m_u = glm::normalize(glm::cross(glm::vec3{0.0f, 1.0f, 0.0f}, w));
+    m_v = glm::cross(w, m_u);
+
+    auto viewport_height = 2.0f * focus_distance * std::tan(fov / 2.0f);
+    auto viewport_width = aspect_ratio * viewport_height;
+
+    m_du = m_u * (viewport_width / widthf);
+    m_dv = -m_v * (viewport_height / heightf);
+    m_start = look_from - 0.5f * viewport_width * m_u + 0.5f * viewport_height * m_v - focus_distance * w + 0.5f * (m_du + m_dv);
+
+    m_defocus_radius = focus_distance * std::tan(defocus_angle / 2);
+
+    // the angle covered by a pixel at the center of the image
+    m_spread = glm::length(m_du) / focus_distance;
+  }
+
+  // pixel_offset is in pixel units, in [-0.5, 0.5)
+  // lens_sample and time are in [0, 1)
+  // without DefocusBlur, rays start at the center of the lens and lens_sample is not used,
+  // which is the same as a lens of radius 0
+  template <bool DefocusBlur = true>
+  auto get_ray(unsigned x, unsigned y, const glm::vec2& pixel_offset, const glm::vec2& lens_sample, float time) const -> Ray {
+    auto direction = m_start +
+      (static_cast<float>(x) + pixel_offset.x) * m_du +
+      (static_cast<float>(y) + pixel_offset.y) * m_dv;
+
+    if constexpr (!DefocusBlur) {
+      return Ray{m_look_from, direction - m_look_from, time, RayCone{0.0f, m_spread}};
+    }
+
+    auto theta = 2.0f * glm::pi<float>() * lens_sample.x;
+    auto r = lens_sample.y;
+    auto cos_sin = math::cos_sin(theta);
+    auto origin = m_look_from + m_defocus_radius * r * (cos_sin.x * m_u + cos_sin.y * m_v);
+
+    return Ray{origin, direction - origin, time, RayCone{0.0f, m_spread}};
+  }
+
+  auto has_defocus_blur() const -> bool {
+    return m_defocus_radius > 0.0f;
+  }
+
+private:
+  glm::vec3 m_look_from{};
+  glm::vec3 m_u{};
+  glm::vec3 m_v{};
+  glm::vec3 m_du{};
+  glm::vec3 m_dv{};
+  glm::vec3 m_start{};
+  float m_defocus_radius{};
+  float m_spread{};
+};
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef RT_CHECKPOINT_HPP
+#define RT_CHECKPOINT_HPP
+
+#include "framebuffer.hpp"
+#include "tracing.hpp"
+
+#include <glm/vec3.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <utility>
+
+// What a checkpoint has to match to be resumed. Samples are a function of the pixel,
+// the sample index and the seed only, so the per pixel sample counts are all the
+// sampler progress there is to store. The tiles and samples a process was assigned
+// are part of it too, which makes the same format work for the partial results of
+// a distributed render. scene_hash identifies the scene and its camera, see get_scene_hash.
+// The crop window is the whole frame when the render is not cropped.
+struct CheckpointHeader {
+  std::array<char, 4> magic{'R', 'T', 'C', 'K'};
+  std::uint32_t version{5};
+  std::uint32_t width{};
+  std::uint32_t height{};
+  std::uint32_t num_samples{};
+  std::uint32_t max_depth{};
+  std::uint32_t sampler{};
+  std::uint32_t seed{};
+  std::uint32_t integrator{};
+  std::uint32_t scene_hash{};
+  std::uint32_t crop_x0{};
+  std::uint32_t crop_y0{};
+  std::uint32_t crop_x1{};
+  std::uint32_t crop_y1{};
+  std::uint32_t tile_index{};
+  std::uint32_t tile_count{1};
+  std::uint32_t sample_begin{};
+  std::uint32_t sample_end{};
+};
+
+// Whether two results are renders of the same image, whatever part of it they hold
+auto same_render(const CheckpointHeader& a, const CheckpointHeader& b) -> bool {
+  return a.magic == b.magic && a.version == b.version && a.width == b.width && a.height == b.height
+    && a.num_samples == b.num_samples && a.max_depth == b.max_depth && a.sampler == b.sampler && a.seed == b.seed
+    && a.integrator == b.integrator && a.scene_hash == b.scene_hash
+    && a.crop_x0 == b.crop_x0 && a.crop_y0 == b.crop_y0 && a.crop_x1 == b.crop_x1 && a.crop_y1 == b.crop_y1;
+}
+
+auto get_crop(const CheckpointHeader& header) -> Region {
+  return Region{header.crop_x0, header.crop_y0, header.crop_x1, header.crop_y1};
+}
+
+auto operator==(const CheckpointHeader& a, const CheckpointHeader& b) -> bool {
+  return same_render(a, b) && a.tile_index == b.tile_index && a.tile_count == b.tile_count
+    && a.sample_begin == b.sample_begin && a.sample_end == b.sample_end;
+}
+
+struct Checkpoint {
+  CheckpointHeader header{};
+  Framebuffer framebuffer{};
+};
+
+// Writes to a temporary file first so that a crash while writing keeps the previous checkpoint
+auto write_checkpoint(const std::string& path, const CheckpointHeader& header, const Framebuffer& framebuffer) -> bool {
+  auto scope = tracing::ScopedTrace{"checkpoint"};
+  auto temp_path = path + ".tmp";
+  {
+    auto file = std::ofstream{temp_path, std::ios::binary};
+    if (!file) {
+      std::cerr << "[ERROR] Failed to open " << temp_path << "\n";
+      return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(framebuffer.accumulation.data()),
+               static_cast<std::streamsize>(framebuffer.accumulation.size() * sizeof(glm::vec3)));
+    file.write(reinterpret_cast<const char*>(framebuffer.sample_counts.data()),
+               static_cast<std::streamsize>(framebuffer.sample_counts.size() * sizeof(unsigned)));
+    if (!file) {
+      std::cerr << "[ERROR] Failed to write " << temp_path << "\n";
+      return false;
+    }
+  }
+
+  auto error = std::error_code{};
+  std::filesystem::rename(temp_path, path, error);
+  if (error) {
+    std::cerr << "[ERROR] Failed to replace " << path << ": " << error.message() << "\n";
+    return false;
+  }
+  return true;
+}
+
+auto read_checkpoint(const std::string& path) -> std::optional<Checkpoint> {
+  auto file = std::ifstream{path, std::ios::binary};
+  if (!file) {
+    std::cerr << "Could not open the checkpoint " << path << '\n';
+    return {};
+  }
+
+  auto checkpoint = Checkpoint{};
+  auto& header = checkpoint.header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file || header.magic != CheckpointHeader{}.magic || header.version != CheckpointHeader{}.version) {
+    std::cerr << "The file " << path << " is not a checkpoint of this version\n";
+    return {};
+  }
+
+  auto& framebuffer = checkpoint.framebuffer;
+  framebuffer = Framebuffer{header.width, header.height};
+  framebuffer.sample_offset = header.sample_begin;
+  file.read(reinterpret_cast<char*>(framebuffer.accumulation.data()),
+            static_cast<std::streamsize>(framebuffer.accumulation.size() * sizeof(glm::vec3)));
+  file.read(reinterpret_cast<char*>(framebuffer.sample_counts.data()),
+            static_cast<std::streamsize>(framebuffer.sample_counts.size() * sizeof(unsigned)));
+  if (!file) {
+    std::cerr << "The checkpoint " << path << " is truncated\n";
+    return {};
+  }
+
+  return checkpoint;
+}
+
+auto read_checkpoint(const std::string& path, const CheckpointHeader& expected) -> std::optional<Framebuffer> {
+  auto checkpoint = read_checkpoint(path);
+  if (!checkpoint) {
+    return {};
+  }
+  if (!(checkpoint->header == expected)) {
+    std::cerr << "The checkpoint " << path << " was saved with different render options\n";
+    return {};
+  }
+  return std::move(checkpoint->framebuffer);
+}
+
+// Saves checkpoints on a background thread, from a copy of the framebuffer,
+// so that rendering goes on while the file is written
+class CheckpointWriter final {
+public:
+  CheckpointWriter(std::string path, const CheckpointHeader& header)
+    : m_path{std::move(path)}
+    , m_header{header}
+  {}
+
+  CheckpointWriter(const CheckpointWriter&) = delete;
+  auto operator=(const CheckpointWriter&) -> CheckpointWriter& = delete;
+
+  ~CheckpointWriter() {
+    wait();
+  }
+
+  // Returns false, without saving, if the previous checkpoint is still being written
+  auto save_async(const Framebuffer& framebuffer) -> bool {
+    if (m_pending.valid() && m_pending.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+      return false;
+    }
+    wait();
+    m_pending = std::async(std::launch::async, [this, snapshot = framebuffer] {
+      return write_checkpoint(m_path, m_header, snapshot);
+    });
+    return true;
+  }
+
+  auto wait() -> bool {
+    if (!m_pending.valid()) {
+      return true;
+    }
+    return m_pending.get();
+  }
+
+private:
+  std::string m_path{};
+  CheckpointHeader m_header{};
+  std::future<bool> m_pending{};
+};
+
+#endif
@@ -0,0 +1,320 @@
+#ifndef RT_COMMAND_LINE_HPP
+#define RT_COMMAND_LINE_HPP
+
+#include "renderer.hpp"
+#include "sampler.hpp"
+#include "framebuffer.hpp"
+
+#include <array>
+#include <charconv>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+struct CommandLine {
+  std::string scene{"cornell_box"};
+  std::string output{"output.ppm"};
+  std::optional<unsigned> num_samples{};
+  std::optional<std::uint32_t> seed{};
+  std::optional<SamplerType> sampler{};
+  bool stream_traversal{};
+  std::string checkpoint_path{};
+  std::optional<float> checkpoint_interval{};
+  bool resume{};
+  unsigned tile_index{};
+  unsigned tile_count{1};
+  std::optional<unsigned> sample_begin{};
+  std::optional<unsigned> sample_end{};
+  bool partial{};
+  std::optional<float> time_budget{};
+  std::optional<Region> crop{};
+  bool preview{};
+  bool denoise{};
+  bool features{};
+  std::optional<Integrator> integrator{};
+  std::optional<float> ao_radius{};
+  std::optional<std::pair<unsigned, unsigned>> frames{};
+  std::string server_socket{};
+  std::string stats_path{};
+  std::string trace_path{};
+  bool counters{};
+  std::string memory_path{};
+  bool numa{};
+  bool numa_replicate{};
+  std::optional<unsigned> texture_cache{};
+};
+
+auto print_usage() -> void {
+  std::cerr << "Usage: ray-tracer [scene] [options]\n"
+            << "  --output <file>                 image to write (output.ppm)\n"
+            << "  --samples <count>               samples per pixel\n"
+            << "  --seed <value>                  seed of the samplers\n"
+            << "  --sampler <sobol|independent>   sample generator\n"
+            << "  --integrator <name>             path, ao, albedo, normals, depth or direct\n"
+            << "  --ao-radius <distance>          distance of the ambient occlusion rays (1)\n"
+            << "  --stream                        trace tiles of rays together\n"
+            << "  --time-budget <seconds>         take as many samples as fit in the time, up to --samples\n"
+            << "  --checkpoint <file>             save the render progress to file\n"
+            << "  --checkpoint-interval <seconds> time between two checkpoints (600)\n"
+            << "  --resume                        continue from the checkpoint\n"
+            << "  --tiles <index>/<count>         render every count-th tile, starting at index\n"
+            << "  --sample-range <begin>:<end>    render the samples in [begin, end)\n"
+            << "  --crop <x0>,<y0>,<x1>,<y1>      only render the pixels from (x0, y0) to (x1, y1) excluded\n"
+            << "  --preview                       write 1/8 and 1/4 resolution images before the full one\n"
+            << "  --denoise                       filter the image guided by the albedo, normals and depth\n"
+            << "  --features                      also write the albedo, normals and depth as images\n"
+            << "  --frames <begin>:<end>          frames of an animated scene to render, written as\n"
+            << "                                  <output>.<frame>.ppm (all of them)\n"
+            << "  --stats <file>                  write the times, ray counts and memory use as JSON\n"
+            << "  --numa                          pin the render threads and place the framebuffer rows on their NUMA nodes\n"
+            << "  --numa-replicate                also build a copy of the scene on every NUMA node, implies --numa\n"
+            << "  --memory <file>                 write the bytes used by the scene objects and the peak memory as JSON\n"
+            << "  --texture-cache <MiB>           memory budget of the textures of models, decoded when first seen (no limit)\n"
+            << "  --counters                      add hardware counters of the BVH build and render to --stats\n"
+            << "  --trace <file>                  write a Chrome trace of the scene setup, tiles and output\n"
+            << "  --serve <socket>                render the jobs sent to a Unix domain socket, see server.hpp\n"
+            << "  --partial                       write the samples instead of an image, to be merged\n"
+            << "                                  with ray-tracer-merge\n";
+}
+
+template <typename T>
+auto parse_number(std::string_view text) -> std::optional<T> {
+  auto value = T{};
+  auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+  if (error != std::errc{} || end != text.data() + text.size()) {
+    return {};
+  }
+  return value;
+}
+
+// Parses "<first><separator><second>", like 1/4 or 0:64
+auto parse_pair(std::string_view text, char separator) -> std::optional<std::pair<unsigned, unsigned>> {
+  auto position = text.find(separator);
+  if (position == std::string_view::npos) {
+    return {};
+  }
+  auto first = parse_number<unsigned>(text.substr(0, position));
+  auto second = parse_number<unsigned>(text.substr(position + 1));
+  if (!first || !second) {
+    return {};
+  }
+  return std::pair{*first, *second};
+}
+
+auto parse_region(std::string_view text) -> std::optional<Region> {
+  auto values = std::array<unsigned, 4>{};
+  for (auto i = 0uz; i < values.size(); ++i) {
+    auto end = i + 1 < values.size() ? text.find(',') : text.size();
+    if (end == std::string_view::npos) {
+      return {};
+    }
+    auto value = parse_number<unsigned>(text.substr(0, end));
+    if (!value) {
+      return {};
+    }
+    values[i] = *value;
+    text.remove_prefix(std::min(end + 1, text.size()));
+  }
+  if (values[0] >= values[2] || values[1] >= values[3]) {
+    return {};
+  }
+  return Region{values[0], values[1], values[2], values[3]};
+}
+
+auto parse_command_line(std::span<char*> args) -> std::optional<CommandLine> {
+  auto command_line = CommandLine{};
+
+  for (auto i = 1uz; i < args.size(); ++i) {
+    auto arg = std::string_view{args[i]};
+
+    auto next = [&]() -> std::optional<std::string_view> {
+      if (i + 1 >= args.size()) {
+        std::cerr << "Missing value for " << arg << '\n';
+        return {};
+      }
+      return std::string_view{args[++i]};
+    };
+
+    auto parse_value = [&]<typename T>(std::optional<T>& target) -> bool {
+      auto value = next();
+      if (!value) {
+        return false;
+      }
+      target = parse_number<T>(*value);
+      if (!target) {
+        std::cerr << "Invalid value for " << arg << ": " << *value << '\n';
+        return false;
+      }
+      return true;
+    };
+
+    if (arg == "--output" || arg == "--checkpoint" || arg == "--serve" || arg == "--stats"
+        || arg == "--trace" || arg == "--memory") {
+      auto value = next();
+      if (!value) return {};
+      auto& target = arg == "--output" ? command_line.output
+        : arg == "--checkpoint" ? command_line.checkpoint_path
+        : arg == "--serve" ? command_line.server_socket
+        : arg == "--stats" ? command_line.stats_path
+        : arg == "--trace" ? command_line.trace_path
+        : command_line.memory_path;
+      target = *value;
+    }
+    else if (arg == "--samples") {
+      if (!parse_value(command_line.num_samples)) return {};
+    }
+    else if (arg == "--seed") {
+      if (!parse_value(command_line.seed)) return {};
+    }
+    else if (arg == "--time-budget") {
+      if (!parse_value(command_line.time_budget)) return {};
+    }
+    else if (arg == "--checkpoint-interval") {
+      if (!parse_value(command_line.checkpoint_interval)) return {};
+    }
+    else if (arg == "--sampler") {
+      auto value = next();
+      if (!value) return {};
+      if (*value == "sobol") {
+        command_line.sampler = SamplerType::sobol;
+      }
+      else if (*value == "independent") {
+        command_line.sampler = SamplerType::independent;
+      }
+      else {
+        std::cerr << "Unknown sampler " << *value << '\n';
+        return {};
+      }
+    }
+    else if (arg == "--frames") {
+      auto value = next();
+      if (!value) return {};
+      command_line.frames = parse_pair(*value, ':');
+      if (!command_line.frames || command_line.frames->first >= command_line.frames->second) {
+        std::cerr << "Invalid value for " << arg << ": " << *value << '\n';
+        return {};
+      }
+    }
+    else if (arg == "--tiles" || arg == "--sample-range") {
+      auto value = next();
+      if (!value) return {};
+      auto is_tiles = arg == "--tiles";
+      auto range = parse_pair(*value, is_tiles ? '/' : ':');
+      if (!range || range->first >= range->second) {
+        std::cerr << "Invalid value for " << arg << ": " << *value << '\n';
+        return {};
+      }
+      if (is_tiles) {
+        command_line.tile_index = range->first;
+        command_line.tile_count = range->second;
+      }
+      else {
+        command_line.sample_begin = range->first;
+        command_line.sample_end = range->second;
+      }
+    }
+    else if (arg == "--crop") {
+      auto value = next();
+      if (!value) return {};
+      command_line.crop = parse_region(*value);
+      if (!command_line.crop) {
+        std::cerr << "Invalid value for " << arg << ": " << *value << '\n';
+        return {};
+      }
+    }
+    else if (arg == "--preview") {
+      command_line.preview = true;
+    }
+    else if (arg == "--denoise") {
+      command_line.denoise = true;
+    }
+    else if (arg == "--features") {
+      command_line.features = true;
+    }
+    else if (arg == "--counters") {
+      command_line.counters = true;
+    }
+    else if (arg == "--numa") {
+      command_line.numa = true;
+    }
+    else if (arg == "--numa-replicate") {
+      command_line.numa = true;
+      command_line.numa_replicate = true;
+    }
+    else if (arg == "--partial") {
+      command_line.partial = true;
+    }
+    else if (arg == "--integrator") {
+      auto value = next();
+      if (!value) return {};
+      static const auto integrators = std::array{
+        std::pair{std::string_view{"path"}, Integrator::path},
+        std::pair{std::string_view{"ao"}, Integrator::ambient_occlusion},
+        std::pair{std::string_view{"albedo"}, Integrator::albedo},
+        std::pair{std::string_view{"normals"}, Integrator::normals},
+        std::pair{std::string_view{"depth"}, Integrator::depth},
+        std::pair{std::string_view{"direct"}, Integrator::direct},
+      };
+      auto it = std::ranges::find(integrators, *value, &std::pair<std::string_view, Integrator>::first);
+      if (it == integrators.end()) {
+        std::cerr << "Unknown integrator " << *value << '\n';
+        return {};
+      }
+      command_line.integrator = it->second;
+    }
+    else if (arg == "--ao-radius") {
+      if (!parse_value(command_line.ao_radius)) return {};
+    }
+    else if (arg == "--texture-cache") {
+      if (!parse_value(command_line.texture_cache)) return {};
+    }
+    else if (arg == "--stream") {
+      command_line.stream_traversal = true;
+    }
+    else if (arg == "--resume") {
+      command_line.resume = true;
+    }
+    else if (arg.starts_with("--")) {
+      std::cerr << "Unknown option " << arg << '\n';
+      return {};
+    }
+    else {
+      command_line.scene = arg;
+    }
+  }
+
+  if (command_line.resume && command_line.checkpoint_path.empty()) {
+    std::cerr << "--resume needs a --checkpoint file\n";
+    return {};
+  }
+
+  return command_line;
+}
+
+// Overrides the options of the scene with the ones given on the command line
+auto apply_command_line(const CommandLine& command_line, RenderOptions& options) -> void {
+  if (command_line.num_samples) options.num_samples = *command_line.num_samples;
+  if (command_line.seed) options.seed = *command_line.seed;
+  if (command_line.sampler) options.sampler = *command_line.sampler;
+  if (command_line.checkpoint_interval) options.checkpoint_interval = *command_line.checkpoint_interval;
+  options.stream_traversal = options.stream_traversal || command_line.stream_traversal;
+  options.checkpoint_path = command_line.checkpoint_path;
+  options.resume = command_line.resume;
+  options.tile_index = command_line.tile_index;
+  options.tile_count = command_line.tile_count;
+  if (command_line.sample_begin) options.sample_begin = *command_line.sample_begin;
+  if (command_line.sample_end) options.sample_end = *command_line.sample_end;
+  if (command_line.time_budget) options.time_budget = *command_line.time_budget;
+  if (command_line.crop) options.crop = *command_line.crop;
+  options.preview = command_line.preview;
+  options.numa = options.numa || command_line.numa;
+  if (command_line.integrator) options.integrator = *command_line.integrator;
+  if (command_line.ao_radius) options.ao_radius = *command_line.ao_radius;
+}
+
+#endif
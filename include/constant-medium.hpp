@@ -4,21 +4,40 @@
 #include "hittable.hpp"
 #include "material.hpp"
 #include "texture.hpp"
+#include "sampler.hpp"
+#include "math.hpp"
 
 #include <glm/geometric.hpp>
 
+#include <atomic>
+#include <cstdint>
+
 class ConstantMedium : public Hittable {
 public:
   ConstantMedium(const std::shared_ptr<Hittable>& boundary, float density, const std::shared_ptr<Texture>& texture)
-    : m_bounding_box(boundary), m_density(density), m_material(std::make_shared<Isotropic>(texture)) {}
+    : m_bounding_box(boundary), m_density(density), m_material(std::make_shared<Isotropic>(texture)), m_id(new_id()) {}
 
   ConstantMedium(const std::shared_ptr<Hittable>& boundary, float density, const glm::vec3& color)
-    : m_bounding_box(boundary), m_density(density), m_material(std::make_shared<Isotropic>(color)) {}
+    : m_bounding_box(boundary), m_density(density), m_material(std::make_shared<Isotropic>(color)), m_id(new_id()) {}
 
   auto bounding_box() const -> Aabb override {
     return m_bounding_box->bounding_box();
   }
 
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      account.add(memory::Category::media, sizeof(*this));
+      m_bounding_box->account(account);
+      m_material->account(account);
+    }
+  }
+
+  // the boundary is only used to find where the ray is inside, but it may move
+  auto add_features(SceneFeatures& features) const -> void override {
+    features.media = true;
+    m_bounding_box->add_features(features);
+  }
+
   auto hit(const Ray& ray, float min_distance, float max_distance) const -> std::optional<HitRecord> override {
     auto hit1 = m_bounding_box->hit(ray, -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity());
     if (!hit1) {
@@ -47,7 +66,7 @@ public:
     }
 
     auto distance_inside_boundary = (hit2->distance - hit1->distance) * glm::length(ray.direction());
-    auto hit_distance = -(1.0f / m_density) * std::log(prng::get_real(0.0f, 1.0f));
+    auto hit_distance = -(1.0f / m_density) * math::log(1.0f - sampling::current().get_medium_1d(m_id));
 
     if (hit_distance > distance_inside_boundary) {
       return {};
@@ -56,13 +75,20 @@ public:
     auto distance = hit1->distance + hit_distance / glm::length(ray.direction());
     auto point = ray.at(distance);
 
-    return HitRecord{distance, true, point, glm::vec3{0.0f}, m_material, glm::vec2{}};
+    return HitRecord{distance, true, point, glm::vec3{0.0f}, m_material.get(), glm::vec2{}};
   }
 
 private:
   std::shared_ptr<Hittable> m_bounding_box{};
   float m_density{};
   std::shared_ptr<Material> m_material{};
+  // in the order the media are built, so that a scene draws the same values in every run
+  std::uint32_t m_id{};
+
+  static auto new_id() -> std::uint32_t {
+    static auto next_id = std::atomic<std::uint32_t>{};
+    return next_id++;
+  }
 };
 
 #endif
\ No newline at end of file
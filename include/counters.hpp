@@ -0,0 +1,212 @@
+#ifndef RT_COUNTERS_HPP
+#define RT_COUNTERS_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// Hardware performance counters of the user space code, read with perf_event_open. Every
+// thread opens its own counters the first time it counts, and a scope adds what they counted
+// while it was open to the totals of its section. Events the system does not allow, as in
+// most containers, are left out, and without any counting costs a flag check.
+namespace counters {
+  enum class Event {
+    cycles,
+    instructions,
+    l1d_misses,
+    llc_misses,
+    branch_misses,
+    count,
+  };
+
+  constexpr auto event_names = std::array{"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+
+  enum class Section {
+    bvh_build,
+    // the tiles of every render pass, counted by each render thread
+    render,
+    count,
+  };
+
+  constexpr auto section_names = std::array{"bvh_build", "render"};
+
+  using Values = std::array<std::uint64_t, static_cast<std::size_t>(Event::count)>;
+
+  auto enabled = std::atomic<bool>{};
+  // one bit per event that could be opened
+  auto available = std::atomic<unsigned>{};
+  auto totals = std::array<std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(Event::count)>,
+                           static_cast<std::size_t>(Section::count)>{};
+  auto warning = std::once_flag{};
+
+#if defined(__linux__)
+
+  auto open_event(Event event, int group) -> int {
+    auto attributes = perf_event_attr{};
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    switch (event) {
+      case Event::cycles: attributes.config = PERF_COUNT_HW_CPU_CYCLES; break;
+      case Event::instructions: attributes.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+      case Event::l1d_misses:
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+      case Event::llc_misses: attributes.config = PERF_COUNT_HW_CACHE_MISSES; break;
+      case Event::branch_misses: attributes.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+      case Event::count: return -1;
+    }
+    attributes.read_format = PERF_FORMAT_GROUP;
+    // counting the kernel needs more privileges than counting the process itself
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, group, 0));
+  }
+
+  // The counters of the calling thread, read together as a group
+  class ThreadCounters final {
+  public:
+    ThreadCounters() {
+      auto error = 0;
+      for (auto event = 0uz; event < event_names.size(); ++event) {
+        auto fd = open_event(static_cast<Event>(event), m_leader);
+        if (fd < 0) {
+          error = errno;
+          continue;
+        }
+        if (m_leader < 0) {
+          m_leader = fd;
+        }
+        m_fds.push_back(fd);
+        m_events.push_back(static_cast<Event>(event));
+        available |= 1u << event;
+      }
+      if (m_events.size() < event_names.size()) {
+        std::call_once(warning, [&] {
+          std::cerr << "[WARNING] Some hardware counters are not available: " << std::strerror(error) << "\n";
+        });
+      }
+    }
+
+    ThreadCounters(const ThreadCounters&) = delete;
+    auto operator=(const ThreadCounters&) -> ThreadCounters& = delete;
+
+    ~ThreadCounters() {
+      for (auto fd : m_fds) {
+        close(fd);
+      }
+    }
+
+    auto read_values() const -> std::optional<Values> {
+      if (m_leader < 0) {
+        return {};
+      }
+      // the number of events, then their values in the order they were opened
+      auto buffer = std::array<std::uint64_t, static_cast<std::size_t>(Event::count) + 1>{};
+      auto size = static_cast<long>((m_events.size() + 1) * sizeof(std::uint64_t));
+      if (read(m_leader, buffer.data(), static_cast<std::size_t>(size)) != size) {
+        return {};
+      }
+      auto values = Values{};
+      for (auto i = 0uz; i < m_events.size(); ++i) {
+        values[static_cast<std::size_t>(m_events[i])] = buffer[i + 1];
+      }
+      return values;
+    }
+
+  private:
+    int m_leader{-1};
+    std::vector<int> m_fds{};
+    std::vector<Event> m_events{};
+  };
+
+#else
+
+  class ThreadCounters final {
+  public:
+    ThreadCounters() {
+      std::call_once(warning, [] {
+        std::cerr << "[WARNING] Hardware counters need perf_event_open, which is only on Linux\n";
+      });
+    }
+
+    auto read_values() const -> std::optional<Values> {
+      return {};
+    }
+  };
+
+#endif
+
+  auto thread_counters() -> const ThreadCounters& {
+    thread_local const auto counters = ThreadCounters{};
+    return counters;
+  }
+
+  // Zeroes the totals, not thread safe with counting
+  auto reset() -> void {
+    for (auto& section : totals) {
+      for (auto& total : section) {
+        total = 0;
+      }
+    }
+  }
+
+  auto start() -> void {
+    reset();
+    enabled = true;
+  }
+
+  auto total(Section section, Event event) -> std::uint64_t {
+    return totals[static_cast<std::size_t>(section)][static_cast<std::size_t>(event)].load();
+  }
+
+  auto is_available(Event event) -> bool {
+    return (available.load() & (1u << static_cast<unsigned>(event))) != 0;
+  }
+
+  class Scope final {
+  public:
+    explicit Scope(Section section)
+      : m_section{section}
+    {
+      if (enabled.load(std::memory_order_relaxed)) [[unlikely]] {
+        m_begin = thread_counters().read_values();
+      }
+    }
+
+    Scope(const Scope&) = delete;
+    auto operator=(const Scope&) -> Scope& = delete;
+
+    ~Scope() {
+      if (!m_begin) [[likely]] {
+        return;
+      }
+      auto end = thread_counters().read_values();
+      if (!end) {
+        return;
+      }
+      auto& section_totals = totals[static_cast<std::size_t>(m_section)];
+      for (auto event = 0uz; event < section_totals.size(); ++event) {
+        section_totals[event] += (*end)[event] - (*m_begin)[event];
+      }
+    }
+
+  private:
+    Section m_section{};
+    std::optional<Values> m_begin{};
+  };
+}
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef RT_DENOISER_HPP
+#define RT_DENOISER_HPP
+
+#include "framebuffer.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+// First hit features of each pixel, averaged over its samples. Pixels whose rays
+// miss the scene have an albedo of 1, a normal of 0 and a depth of 0.
+struct FeatureBuffers {
+  FeatureBuffers() = default;
+
+  FeatureBuffers(unsigned width, unsigned height)
+    : width{width}
+    , height{height}
+    , albedo(static_cast<std::size_t>(width) * height)
+    , normal(static_cast<std::size_t>(width) * height)
+    , depth(static_cast<std::size_t>(width) * height)
+  {}
+
+  unsigned width{};
+  unsigned height{};
+  std::vector<glm::vec3> albedo{};
+  std::vector<glm::vec3> normal{};
+  std::vector<float> depth{};
+};
+
+struct DenoiseOptions {
+  unsigned iterations{5};
+  float sigma_color{1.0f};
+  float sigma_normal{0.3f};
+  float sigma_depth{0.05f};
+};
+
+// Edge-avoiding à-trous wavelet filter (Dammertz et al. 2010, "Edge-Avoiding À-Trous
+// Wavelet Transform for fast Global Illumination Filtering"). Every iteration blurs
+// with a 5x5 B3 spline kernel whose taps are twice as far apart as in the previous one,
+// and a tap only counts as much as its normal, depth and color are close to the ones
+// of the center pixel. The color is divided by the albedo before filtering and
+// multiplied back after, so that textures stay sharp.
+// Returns the color of every pixel of the framebuffer, only the region is filtered.
+auto denoise(const Framebuffer& framebuffer, const FeatureBuffers& features, const Region& region,
+             const DenoiseOptions& options = {}) -> std::vector<glm::vec3> {
+  constexpr auto kernel = std::array{1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+  constexpr auto tile_size = 32u;
+  constexpr auto min_albedo = 0.01f;
+
+  auto width = framebuffer.width;
+  auto result = std::vector<glm::vec3>(framebuffer.accumulation.size());
+  for (auto i = 0uz; i < result.size(); ++i) {
+    result[i] = framebuffer.color(i) / glm::max(features.albedo[i], glm::vec3{min_albedo});
+  }
+  auto filtered = result;
+
+  // a lone pixel much brighter than its neighbors would be kept by the color weights,
+  // so each pixel is first limited to the brightest of its 8 neighbors
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (auto y = region.y0; y < region.y1; ++y) {
+    for (auto x = region.x0; x < region.x1; ++x) {
+      auto neighbors_max = glm::vec3{0.0f};
+      for (auto sample_y = std::max(y, region.y0 + 1) - 1; sample_y < std::min(y + 2, region.y1); ++sample_y) {
+        for (auto sample_x = std::max(x, region.x0 + 1) - 1; sample_x < std::min(x + 2, region.x1); ++sample_x) {
+          if (sample_x != x || sample_y != y) {
+            neighbors_max = glm::max(neighbors_max, result[sample_y * width + sample_x]);
+          }
+        }
+      }
+      filtered[y * width + x] = glm::min(result[y * width + x], neighbors_max);
+    }
+  }
+  std::swap(result, filtered);
+
+  auto tiles_x = (region.width() + tile_size - 1) / tile_size;
+  auto tiles_y = (region.height() + tile_size - 1) / tile_size;
+  auto sigma_color = options.sigma_color;
+
+  for (auto iteration = 0u; iteration < options.iterations; ++iteration) {
+    auto step = static_cast<int>(1u << iteration);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (auto tile = 0u; tile < tiles_x * tiles_y; ++tile) {
+      auto x0 = region.x0 + (tile % tiles_x) * tile_size;
+      auto y0 = region.y0 + (tile / tiles_x) * tile_size;
+      for (auto y = y0; y < std::min(y0 + tile_size, region.y1); ++y) {
+        for (auto x = x0; x < std::min(x0 + tile_size, region.x1); ++x) {
+          auto center = y * width + x;
+          auto sum = glm::vec3{0.0f};
+          auto weight_sum = 0.0f;
+
+          for (auto j = 0; j < 5; ++j) {
+            auto sample_y = static_cast<int>(y) + (j - 2) * step;
+            if (sample_y < static_cast<int>(region.y0) || sample_y >= static_cast<int>(region.y1)) {
+              continue;
+            }
+            for (auto i = 0; i < 5; ++i) {
+              auto sample_x = static_cast<int>(x) + (i - 2) * step;
+              if (sample_x < static_cast<int>(region.x0) || sample_x >= static_cast<int>(region.x1)) {
+                continue;
+              }
+              auto pixel = static_cast<unsigned>(sample_y) * width + static_cast<unsigned>(sample_x);
+
+              auto color_distance = result[pixel] - result[center];
+              auto normal_distance = features.normal[pixel] - features.normal[center];
+              auto depth_distance = std::abs(features.depth[pixel] - features.depth[center])
+                / std::max({features.depth[pixel], features.depth[center], 1e-4f});
+
+              auto weight = kernel[static_cast<std::size_t>(i)] * kernel[static_cast<std::size_t>(j)]
+                * std::exp(-glm::dot(color_distance, color_distance) / (sigma_color * sigma_color)
+                           - glm::dot(normal_distance, normal_distance) / (options.sigma_normal * options.sigma_normal)
+                           - depth_distance * depth_distance / (options.sigma_depth * options.sigma_depth));
+              sum += result[pixel] * weight;
+              weight_sum += weight;
+            }
+          }
+
+          filtered[center] = sum / weight_sum;
+        }
+      }
+    }
+
+    std::swap(result, filtered);
+    // the noise left is smaller after each iteration
+    sigma_color *= 0.5f;
+  }
+
+  for (auto i = 0uz; i < result.size(); ++i) {
+    result[i] *= glm::max(features.albedo[i], glm::vec3{min_albedo});
+  }
+  return result;
+}
+
+#endif
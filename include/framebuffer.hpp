@@ -0,0 +1,88 @@
+#ifndef RT_FRAMEBUFFER_HPP
+#define RT_FRAMEBUFFER_HPP
+
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// A rectangle of pixels, from (x0, y0) to (x1, y1) excluded
+struct Region {
+  unsigned x0{};
+  unsigned y0{};
+  unsigned x1{};
+  unsigned y1{};
+
+  auto width() const -> unsigned { return x1 - x0; }
+  auto height() const -> unsigned { return y1 - y0; }
+};
+
+// Default initializes the elements, which leaves the ones of trivial types unwritten. The pages
+// of a large buffer are then only placed on a NUMA node when a thread first writes them.
+template <typename T>
+struct UninitializedAllocator : std::allocator<T> {
+  template <typename U>
+  struct rebind {
+    using other = UninitializedAllocator<U>;
+  };
+
+  UninitializedAllocator() = default;
+
+  template <typename U>
+  UninitializedAllocator(const UninitializedAllocator<U>&) {}
+
+  template <typename U>
+  auto construct(U* pointer) -> void {
+    ::new (static_cast<void*>(pointer)) U;
+  }
+
+  template <typename U, typename... Args>
+  auto construct(U* pointer, Args&&... args) -> void {
+    ::new (static_cast<void*>(pointer)) U(std::forward<Args>(args)...);
+  }
+};
+
+// Sum of the radiance samples of each pixel, and how many samples were taken.
+// A pixel that took n samples took the ones numbered sample_offset to sample_offset + n.
+struct Framebuffer {
+  // Leaves the pixels unwritten, each row has to be cleared once
+  struct Unwritten {};
+
+  Framebuffer() = default;
+
+  Framebuffer(unsigned width, unsigned height, Unwritten)
+    : width{width}
+    , height{height}
+    , accumulation(static_cast<std::size_t>(width) * height)
+    , sample_counts(static_cast<std::size_t>(width) * height)
+  {}
+
+  Framebuffer(unsigned width, unsigned height)
+    : Framebuffer{width, height, Unwritten{}}
+  {
+    clear_rows(0, height);
+  }
+
+  auto clear_rows(unsigned y0, unsigned y1) -> void {
+    std::fill(accumulation.begin() + y0 * width, accumulation.begin() + y1 * width, glm::vec3{0.0f});
+    std::fill(sample_counts.begin() + y0 * width, sample_counts.begin() + y1 * width, 0u);
+  }
+
+  auto color(std::size_t pixel) const -> glm::vec3 {
+    if (sample_counts[pixel] == 0) {
+      return glm::vec3{0.0f};
+    }
+    return accumulation[pixel] / static_cast<float>(sample_counts[pixel]);
+  }
+
+  unsigned width{};
+  unsigned height{};
+  unsigned sample_offset{};
+  std::vector<glm::vec3, UninitializedAllocator<glm::vec3>> accumulation{};
+  std::vector<unsigned, UninitializedAllocator<unsigned>> sample_counts{};
+};
+
+#endif
@@ -3,12 +3,16 @@
 
 #include "ray.hpp"
 #include "aabb.hpp"
+#include "sampler.hpp"
+#include "memory.hpp"
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 
 #include <optional>
 #include <memory>
+#include <vector>
+#include <span>
 
 class Material;
 
@@ -17,8 +21,35 @@ struct HitRecord {
   bool front_face{};
   glm::vec3 point{};
   glm::vec3 normal{};
-  std::shared_ptr<Material> material{};
+  // owned by the object hit
+  const Material* material{};
   glm::vec2 texture_coords{};
+  // texture coordinates per unit of distance around the point, to size the ray footprint on textures
+  float texture_scale{};
+};
+
+// Rays traced together through the scene. hits[i] holds the closest hit found so far for rays[i],
+// and max_distances[i] its distance. While a bundle of rays sharing a direction octant is traced,
+// interval bounds it so that a box can be rejected for all its rays with a single test.
+// sampler_states[i] is where the path of rays[i] is in its sample sequence, for media that
+// draw samples while being hit. Media do not move the sequence, so the states are only read.
+// It is empty when the scene has no media.
+struct RayStream {
+  std::vector<Ray> rays{};
+  std::vector<SamplerState> sampler_states{};
+  std::vector<glm::vec3> inv_directions{};
+  std::vector<float> max_distances{};
+  std::vector<std::optional<HitRecord>> hits{};
+  std::optional<RayInterval> interval{};
+};
+
+// The parts of the renderer that a scene needs, the render kernel leaves the others out
+struct SceneFeatures {
+  // spheres moving during the exposure, whose rays need a time
+  bool motion_blur{};
+  bool media{};
+  // emissive surfaces
+  bool lights{};
 };
 
 class Hittable {
@@ -26,6 +57,27 @@ public:
   virtual ~Hittable() = default;
   virtual auto hit(const Ray& ray, float min_distance, float max_distance) const -> std::optional<HitRecord> = 0;
   virtual auto bounding_box() const -> Aabb = 0;
+  // Adds the bytes of this object and of what it holds, see memory.hpp
+  virtual auto account(memory::Account& account) const -> void = 0;
+  // Sets the features this object and what it holds need
+  virtual auto add_features(SceneFeatures& features) const -> void = 0;
+
+  // Intersects the rays of the stream whose indices are in active, keeping the closest hit of each one.
+  // The order of the indices in active may be changed.
+  virtual auto hit_stream(RayStream& stream, std::span<unsigned> active) const -> void {
+    auto& sampler = sampling::current();
+    auto media = !stream.sampler_states.empty();
+    for (auto index : active) {
+      if (media) {
+        sampler.set_state(stream.sampler_states[index]);
+      }
+      auto hit_record = hit(stream.rays[index], 0.0f, stream.max_distances[index]);
+      if (hit_record) {
+        stream.max_distances[index] = hit_record->distance;
+        stream.hits[index] = std::move(hit_record);
+      }
+    }
+  }
 };
 
 using Hittables = std::vector<std::shared_ptr<Hittable>>;
@@ -53,6 +105,17 @@ public:
     return m_bounding_box;
   }
 
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      account.add(memory::Category::instances, sizeof(*this));
+      m_hittable->account(account);
+    }
+  }
+
+  auto add_features(SceneFeatures& features) const -> void override {
+    m_hittable->add_features(features);
+  }
+
 private:
   std::shared_ptr<Hittable> m_hittable{};
   glm::vec3 m_offset{};
@@ -139,6 +202,17 @@ public:
   auto bounding_box() const -> Aabb override {
     return m_bounding_box;
   }
+
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      account.add(memory::Category::instances, sizeof(*this));
+      m_hittable->account(account);
+    }
+  }
+
+  auto add_features(SceneFeatures& features) const -> void override {
+    m_hittable->add_features(features);
+  }
   
 private:
   std::shared_ptr<Hittable> m_hittable{};
@@ -1,36 +1,231 @@
 #ifndef RT_IMAGE_HPP
 #define RT_IMAGE_HPP
 
+#include "stats.hpp"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #include <glm/vec3.hpp>
+#include <glm/gtc/packing.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 #include <optional>
 
-struct Image {
-  std::vector<glm::vec3> pixels{};
-  unsigned width{};
-  unsigned height{};
+// The gamma that stb_image assumes to convert 8-bit images to linear values
+constexpr auto g_image_gamma = 2.2f;
+
+// Linear values of the 8-bit channels
+inline const auto g_decode_table = [] {
+  auto table = std::array<float, 256>{};
+  for (auto i = 0uz; i < table.size(); ++i) {
+    table[i] = std::pow(static_cast<float>(i) / 255.0f, g_image_gamma);
+  }
+  return table;
+}();
+
+auto encode_channel(float value) -> std::uint8_t {
+  auto encoded = std::pow(std::clamp(value, 0.0f, 1.0f), 1.0f / g_image_gamma) * 255.0f + 0.5f;
+  return static_cast<std::uint8_t>(encoded);
+}
+
+// An RGB image stored in its native precision: 8-bit gamma encoded channels decoded through a
+// table, or half floats for high dynamic range images. Pixels are stored by tiles of 4x4 aligned
+// to cache lines, with a fourth unused channel: a tile of 8-bit pixels fills one cache line of 64
+// bytes and a tile of half floats two, so the pixels that bilinear filtering reads together are
+// usually in the same line.
+class Image {
+public:
+  enum class Format : std::uint8_t {
+    rgb8,
+    rgb16f,
+  };
+
+  static constexpr auto tile_size = 4u;
+
+  Image() = default;
+
+  Image(unsigned width, unsigned height, Format format)
+    : m_width{width}
+    , m_height{height}
+    , m_format{format}
+    , m_tiles_per_row{(width + tile_size - 1u) / tile_size}
+  {
+    auto num_tiles = static_cast<std::size_t>(m_tiles_per_row) * ((height + tile_size - 1u) / tile_size);
+    if (format == Format::rgb8) {
+      m_byte_tiles.resize(num_tiles);
+    } else {
+      m_half_tiles.resize(num_tiles);
+    }
+  }
+
+  auto width() const -> unsigned {
+    return m_width;
+  }
+
+  auto height() const -> unsigned {
+    return m_height;
+  }
+
+  auto format() const -> Format {
+    return m_format;
+  }
+
+  auto at(unsigned i, unsigned j) const -> glm::vec3 {
+    auto tile = tile_index(i, j);
+    auto index = channel_index(i, j);
+    if (m_format == Format::rgb8) {
+      const auto& bytes = m_byte_tiles[tile].channels;
+      return glm::vec3{g_decode_table[bytes[index]], g_decode_table[bytes[index + 1]], g_decode_table[bytes[index + 2]]};
+    }
+    const auto& halfs = m_half_tiles[tile].channels;
+    return glm::vec3{glm::unpackHalf1x16(halfs[index]), glm::unpackHalf1x16(halfs[index + 1]), glm::unpackHalf1x16(halfs[index + 2])};
+  }
+
+  auto set(unsigned i, unsigned j, const glm::vec3& color) -> void {
+    auto tile = tile_index(i, j);
+    auto index = channel_index(i, j);
+    for (auto c = 0; c < 3; ++c) {
+      if (m_format == Format::rgb8) {
+        m_byte_tiles[tile].channels[index + static_cast<std::size_t>(c)] = encode_channel(color[c]);
+      } else {
+        m_half_tiles[tile].channels[index + static_cast<std::size_t>(c)] = glm::packHalf1x16(color[c]);
+      }
+    }
+  }
+
+  // Stores the channels of an 8-bit image as they are
+  auto set_bytes(unsigned i, unsigned j, const std::uint8_t* rgb) -> void {
+    auto& bytes = m_byte_tiles[tile_index(i, j)].channels;
+    std::copy_n(rgb, 3, bytes.begin() + static_cast<std::ptrdiff_t>(channel_index(i, j)));
+  }
+
+  // Bytes used by the pixels
+  auto size() const -> std::size_t {
+    return m_byte_tiles.size() * sizeof(ByteTile) + m_half_tiles.size() * sizeof(HalfTile);
+  }
+
+private:
+  static constexpr auto channels_per_tile = 4uz * tile_size * tile_size;
+
+  struct alignas(64) ByteTile {
+    std::array<std::uint8_t, channels_per_tile> channels{};
+  };
+
+  struct alignas(64) HalfTile {
+    std::array<std::uint16_t, channels_per_tile> channels{};
+  };
+
+  unsigned m_width{};
+  unsigned m_height{};
+  Format m_format{};
+  unsigned m_tiles_per_row{};
+  std::vector<ByteTile> m_byte_tiles{};
+  std::vector<HalfTile> m_half_tiles{};
+
+  auto tile_index(unsigned i, unsigned j) const -> std::size_t {
+    return static_cast<std::size_t>(j / tile_size) * m_tiles_per_row + i / tile_size;
+  }
+
+  // index of the first channel of the pixel in its tile
+  static auto channel_index(unsigned i, unsigned j) -> std::size_t {
+    return 4uz * ((j % tile_size) * tile_size + i % tile_size);
+  }
 };
 
+// The image at half the size, each pixel the average of the 2x2 pixels it covers
+auto downsample(const Image& image) -> Image {
+  auto output = Image{std::max(image.width() / 2u, 1u), std::max(image.height() / 2u, 1u), image.format()};
+  for (auto j = 0u; j < output.height(); ++j) {
+    auto j0 = std::min(2u * j, image.height() - 1u);
+    auto j1 = std::min(2u * j + 1u, image.height() - 1u);
+    for (auto i = 0u; i < output.width(); ++i) {
+      auto i0 = std::min(2u * i, image.width() - 1u);
+      auto i1 = std::min(2u * i + 1u, image.width() - 1u);
+      output.set(i, j, 0.25f * (image.at(i0, j0) + image.at(i1, j0) + image.at(i0, j1) + image.at(i1, j1)));
+    }
+  }
+  return output;
+}
+
+// Number of images of the mip chain of an image of the given size
+auto get_num_mip_levels(unsigned width, unsigned height) -> unsigned {
+  auto num_levels = 1u;
+  while (width > 1u || height > 1u) {
+    width = std::max(width / 2u, 1u);
+    height = std::max(height / 2u, 1u);
+    ++num_levels;
+  }
+  return num_levels;
+}
+
+// The image followed by its downsampled versions, down to a single pixel
+auto get_mip_levels(const Image& image) -> std::vector<Image> {
+  auto phase = stats::ScopedPhase{stats::Phase::texture_decode};
+  auto levels = std::vector<Image>{image};
+  while (levels.back().width() > 1u || levels.back().height() > 1u) {
+    levels.push_back(downsample(levels.back()));
+  }
+  return levels;
+}
+
+// The width and height of an image file, without decoding it
+auto get_image_size(const std::string& filepath) -> std::optional<std::pair<unsigned, unsigned>> {
+  auto width = 0;
+  auto height = 0;
+  if (stbi_info(filepath.c_str(), &width, &height, nullptr) == 0) {
+    return {};
+  }
+  return std::pair{static_cast<unsigned>(width), static_cast<unsigned>(height)};
+}
+
+// 8-bit images keep their channels, other images are stored as half floats
 auto load_image(const std::string& filepath) -> std::optional<Image> {
-  auto image = Image{};
+  auto phase = stats::ScopedPhase{stats::Phase::texture_decode};
   stbi_set_flip_vertically_on_load(true);
-  auto fdata = stbi_loadf(filepath.c_str(), reinterpret_cast<int*>(&image.width), reinterpret_cast<int*>(&image.height), nullptr, 3);
+  auto width = 0;
+  auto height = 0;
+  auto hdr = stbi_is_hdr(filepath.c_str()) != 0 || stbi_is_16_bit(filepath.c_str()) != 0;
+
+  if (!hdr) {
+    auto data = stbi_load(filepath.c_str(), &width, &height, nullptr, 3);
+    if (data == nullptr) {
+      return {};
+    }
+
+    auto image = Image{static_cast<unsigned>(width), static_cast<unsigned>(height), Image::Format::rgb8};
+    for (auto j = 0u; j < image.height(); ++j) {
+      for (auto i = 0u; i < image.width(); ++i) {
+        image.set_bytes(i, j, data + 3uz * (i + static_cast<std::size_t>(image.width()) * j));
+      }
+    }
+
+    stbi_image_free(data);
+    return image;
+  }
+
+  auto fdata = stbi_loadf(filepath.c_str(), &width, &height, nullptr, 3);
   if (fdata == nullptr) {
     return {};
   }
 
-  image.pixels.reserve(image.width * image.height);
-  for (auto i = 0u; i < image.width * image.height; ++i) {
-    image.pixels.push_back(glm::vec3{fdata[i * 3], fdata[i * 3 + 1], fdata[i * 3 + 2]});
+  auto image = Image{static_cast<unsigned>(width), static_cast<unsigned>(height), Image::Format::rgb16f};
+  for (auto j = 0u; j < image.height(); ++j) {
+    for (auto i = 0u; i < image.width(); ++i) {
+      auto texel = fdata + 3uz * (i + static_cast<std::size_t>(image.width()) * j);
+      image.set(i, j, glm::vec3{texel[0], texel[1], texel[2]});
+    }
   }
 
   stbi_image_free(fdata);
 
-  return image; 
+  return image;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -4,100 +4,183 @@
 #include "ray.hpp"
 #include "hittable.hpp"
 #include "random.hpp"
+#include "sampler.hpp"
 #include "texture.hpp"
-#include "random.hpp"
+#include "math.hpp"
 
 #include <glm/vec3.hpp>
 #include <glm/geometric.hpp>
 #include <glm/ext/scalar_constants.hpp>
 
-#include <optional>
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
 
 constexpr auto g_bias = 0.0005f;
 
+// the least spread of rays scattered by diffuse materials, so that their texture lookups are
+// blurred like the light they gather
+constexpr auto g_diffuse_spread = 0.125f;
+
+auto near_zero(const glm::vec3& vec) -> bool {
+  const float s = 1e-6f;
+  return (std::abs(vec.x) < s) && (std::abs(vec.y) < s) && (std::abs(vec.z) < s);
+}
+
+// Width of the footprint of the ray at the hit point
+auto footprint_width(const Ray& ray, const HitRecord& hit_record) -> float {
+  return ray.cone().at(hit_record.distance * glm::length(ray.direction()));
+}
+
+auto reflectance(float cosine, float refraction_index) -> float {
+  auto r0 = (1.0f - refraction_index) / (1.0f + refraction_index);
+  r0 = r0 * r0;
+  return r0 + (1.0f - r0) * math::pow5(1.0f - cosine);
+}
+
+// A material of a closed set of types, stored as its type and its parameters. Shading is a
+// switch over the type that the compiler can inline into the renderer, instead of a virtual
+// call, and materials without a texture keep their color in place, as do materials with a
+// checker of two colors. The classes below only build materials of each type.
 class Material {
 public:
-  virtual ~Material() = default;
+  enum class Type : std::uint8_t {
+    lambertian,
+    metal,
+    dielectric,
+    diffuse_light,
+    // scatters in every direction, for media
+    isotropic,
+  };
 
   struct ScatterData {
     glm::vec3 attenuation{};
     Ray scattered{};
-    glm::vec3 emission{};
   };
 
-  virtual auto scatter(const Ray& ray, const HitRecord& hit_record) const -> std::optional<ScatterData> = 0;
-};
+  auto type() const -> Type {
+    return m_type;
+  }
 
-auto near_zero(const glm::vec3& vec) -> bool {
-  const float s = 1e-6f;
-  return (std::abs(vec.x) < s) && (std::abs(vec.y) < s) && (std::abs(vec.z) < s);
-}
+  auto emits_light() const -> bool {
+    return m_type == Type::diffuse_light;
+  }
 
-class Lambertian : public Material {
-public:
-  Lambertian(const glm::vec3& albedo)
-    : m_texture{std::make_shared<SolidColor>(albedo)}
-  {}
+  // Light leaving the hit point, only called on materials that emit light, which do not scatter
+  auto emitted(const Ray& ray, const HitRecord& hit_record) const -> glm::vec3 {
+    return color(hit_record, footprint_width(ray, hit_record));
+  }
 
-  Lambertian(std::shared_ptr<Texture> texture)
-    : m_texture{texture}
-  {}  
+  auto scatter(const Ray& ray, const HitRecord& hit_record) const -> std::optional<ScatterData> {
+    switch (m_type) {
+      case Type::lambertian:
+        return scatter_lambertian(ray, hit_record);
+      case Type::metal:
+        return scatter_metal(ray, hit_record);
+      case Type::dielectric:
+        return scatter_dielectric(ray, hit_record);
+      case Type::isotropic: {
+        auto width = footprint_width(ray, hit_record);
+        auto cone = RayCone{width, std::max(ray.cone().spread, g_diffuse_spread)};
+        return ScatterData{color(hit_record, width), Ray{hit_record.point, sampling::current().get_unit_vector(), ray.time(), cone}};
+      }
+      case Type::diffuse_light:
+        break;
+    }
+    return {};
+  }
+
+  // Color of the surface without lighting, used as a feature by the denoiser
+  auto albedo(const Ray& ray, const HitRecord& hit_record) const -> glm::vec3 {
+    return m_type == Type::dielectric ? glm::vec3{1.0f} : color(hit_record, footprint_width(ray, hit_record));
+  }
+
+  auto account(memory::Account& account) const -> void {
+    if (account.visit(this)) {
+      account.add(memory::Category::materials, sizeof(*this));
+      account.set_material_type(this, type_names[static_cast<std::size_t>(m_type)]);
+      if (m_texture) {
+        m_texture->account(account);
+      }
+    }
+  }
+
+protected:
+  Material(Type type, const glm::vec3& color, std::shared_ptr<Texture> texture, float parameter = 0.0f)
+    : m_type{type}
+    , m_parameter{parameter}
+    , m_color{texture && texture->constant() ? *texture->constant() : color}
+    , m_odd_color{}
+    , m_checker_inv_scale{}
+    , m_texture{texture && texture->constant() ? nullptr : std::move(texture)}
+  {
+    if (auto checker = m_texture ? m_texture->checker_colors() : std::nullopt) {
+      m_color = checker->colors[0];
+      m_odd_color = checker->colors[1];
+      m_checker_inv_scale = checker->inv_scale;
+      m_texture = nullptr;
+    }
+  }
+
+private:
+  static constexpr auto type_names = std::array{"lambertian", "metal", "dielectric", "diffuse_light", "isotropic"};
+
+  Type m_type{};
+  // the fuzz of metals, the refraction index of dielectrics
+  float m_parameter{};
+  // the color when there is no texture, or when the texture is constant and was folded into it.
+  // A checker of two constant colors is folded too, m_color is then the color of its even cells.
+  glm::vec3 m_color{};
+  glm::vec3 m_odd_color{};
+  // 0 when the material is not a folded checker
+  float m_checker_inv_scale{};
+  std::shared_ptr<Texture> m_texture{};
+
+  // width is the footprint of the ray at the hit point, in units of distance
+  auto color(const HitRecord& hit_record, float width) const -> glm::vec3 {
+    if (!m_texture) {
+      if (m_checker_inv_scale != 0.0f && checker_parity(m_checker_inv_scale, hit_record.point) != 0) {
+        return m_odd_color;
+      }
+      return m_color;
+    }
+    auto footprint = width * hit_record.texture_scale;
+    return m_texture->value(hit_record.texture_coords.x, hit_record.texture_coords.y, hit_record.point, footprint);
+  }
 
-  auto scatter(const Ray& ray, const HitRecord& hit_record) const -> std::optional<ScatterData> override {
-    auto scatter_direction = hit_record.normal + prng::get_unit_vector();
+  auto scatter_lambertian(const Ray& ray, const HitRecord& hit_record) const -> ScatterData {
+    auto scatter_direction = hit_record.normal + sampling::current().get_unit_vector();
     if (near_zero(scatter_direction)) {
       scatter_direction = hit_record.normal;
     }
 
     auto point = hit_record.point + hit_record.normal * g_bias;
 
-    auto attenuation = m_texture->value(hit_record.texture_coords.x, hit_record.texture_coords.y, hit_record.point);
-    return ScatterData{attenuation, Ray{point, scatter_direction, ray.time()}};
+    auto width = footprint_width(ray, hit_record);
+    auto cone = RayCone{width, std::max(ray.cone().spread, g_diffuse_spread)};
+    return ScatterData{color(hit_record, width), Ray{point, scatter_direction, ray.time(), cone}};
   }
 
-private:
-  std::shared_ptr<Texture> m_texture{};
-};
- 
-class Metal : public Material {
-public:
-  Metal(const glm::vec3& albedo, float fuzz) 
-  : m_albedo{albedo}
-  , m_fuzz{ fuzz < 1.0f ? fuzz : 1.0f } {}
-
-  auto scatter(const Ray& ray, const HitRecord& hit_record) const -> std::optional<ScatterData> override {
+  auto scatter_metal(const Ray& ray, const HitRecord& hit_record) const -> std::optional<ScatterData> {
     auto reflected = glm::reflect(ray.direction(), hit_record.normal);
-    reflected = glm::normalize(reflected) + (m_fuzz * prng::get_unit_vector());
+    reflected = glm::normalize(reflected) + (m_parameter * sampling::current().get_unit_vector());
     if (glm::dot(reflected, hit_record.normal) <= 0.0f) {
       return {};
     }
 
     auto point = hit_record.point + hit_record.normal * g_bias;
 
-    return ScatterData{m_albedo, Ray{point, reflected, ray.time()}};
+    // mirrors keep the spread of the ray, the curvature of the surface is not accounted for
+    auto cone = RayCone{footprint_width(ray, hit_record), ray.cone().spread};
+    return ScatterData{m_color, Ray{point, reflected, ray.time(), cone}};
   }
 
-private:
-  glm::vec3 m_albedo{};
-  float m_fuzz{};
-};
-
-auto reflectance(float cosine, float refraction_index) -> float {
-  auto r0 = (1.0f - refraction_index) / (1.0f + refraction_index);
-  r0 = r0 * r0;
-  return r0 + (1.0f - r0) * std::pow(1.0f - cosine, 5.0f);
-}
-
-class Dielectric : public Material {
-public:
-  Dielectric(float refraction_index)
-    : m_refraction_index{refraction_index}
-  {}
-
-  auto scatter(const Ray& ray, const HitRecord& hit_record) const -> std::optional<ScatterData> override {
+  auto scatter_dielectric(const Ray& ray, const HitRecord& hit_record) const -> ScatterData {
     auto direction = glm::normalize(ray.direction());
-    auto ri = hit_record.front_face ? (1.0f / m_refraction_index) : m_refraction_index;
+    auto ri = hit_record.front_face ? (1.0f / m_parameter) : m_parameter;
 
     auto cos_theta = std::fmin(glm::dot(-direction, hit_record.normal), 1.0f);
     auto sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
@@ -105,7 +188,7 @@ public:
     auto point = hit_record.point;
 
     auto scattered_direction = glm::vec3{};
-    if (ri * sin_theta > 1.0f || reflectance(cos_theta, ri) > prng::get_real(0.0f, 1.0f)) {
+    if (ri * sin_theta > 1.0f || reflectance(cos_theta, ri) > sampling::current().get_1d()) {
       scattered_direction = glm::reflect(direction, hit_record.normal);
       point += hit_record.normal * g_bias;
     } else {
@@ -113,50 +196,56 @@ public:
       point -= hit_record.normal * g_bias;
     }
 
-    return ScatterData{glm::vec3{1.0f}, Ray{point, scattered_direction, ray.time()}};
+    auto cone = RayCone{footprint_width(ray, hit_record), ray.cone().spread};
+    return ScatterData{glm::vec3{1.0f}, Ray{point, scattered_direction, ray.time(), cone}};
   }
+};
 
-private:
-  float m_refraction_index{};
+class Lambertian final : public Material {
+public:
+  Lambertian(const glm::vec3& albedo)
+    : Material{Type::lambertian, albedo, nullptr}
+  {}
+
+  Lambertian(std::shared_ptr<Texture> texture)
+    : Material{Type::lambertian, glm::vec3{}, std::move(texture)}
+  {}
 };
 
-class DiffuseLight : public Material {
+class Metal final : public Material {
 public:
-  DiffuseLight(std::shared_ptr<Texture> texture)
-    : m_texture{texture}
+  Metal(const glm::vec3& albedo, float fuzz)
+    : Material{Type::metal, albedo, nullptr, fuzz < 1.0f ? fuzz : 1.0f}
   {}
+};
 
-  DiffuseLight(const glm::vec3& color)
-    : m_texture{std::make_shared<SolidColor>(color)}
+class Dielectric final : public Material {
+public:
+  Dielectric(float refraction_index)
+    : Material{Type::dielectric, glm::vec3{1.0f}, nullptr, refraction_index}
   {}
+};
 
-  auto scatter(const Ray&, const HitRecord& hit_record) const -> std::optional<ScatterData> override {
-    auto uv = hit_record.texture_coords;
-    auto emission = m_texture->value(uv.x, uv.y, hit_record.point);
-    return ScatterData{glm::vec3{}, Ray{}, emission};
-  }
+class DiffuseLight final : public Material {
+public:
+  DiffuseLight(std::shared_ptr<Texture> texture)
+    : Material{Type::diffuse_light, glm::vec3{}, std::move(texture)}
+  {}
 
-private:
-  std::shared_ptr<Texture> m_texture{};
+  DiffuseLight(const glm::vec3& color)
+    : Material{Type::diffuse_light, color, nullptr}
+  {}
 };
 
-class Isotropic : public Material {
+class Isotropic final : public Material {
 public:
   Isotropic(std::shared_ptr<Texture> texture)
-    : m_texture{texture}
+    : Material{Type::isotropic, glm::vec3{}, std::move(texture)}
   {}
 
   Isotropic(const glm::vec3& color)
-    : m_texture{std::make_shared<SolidColor>(color)}
+    : Material{Type::isotropic, color, nullptr}
   {}
-
-  auto scatter(const Ray& ray, const HitRecord& hit_record) const -> std::optional<ScatterData> override {
-    auto attenuation = m_texture->value(hit_record.texture_coords.x, hit_record.texture_coords.y, hit_record.point);
-    return ScatterData{attenuation, Ray{hit_record.point, prng::get_unit_vector(), ray.time()}};
-  }
-
-private:
-  std::shared_ptr<Texture> m_texture{};
 };
 
 #endif
\ No newline at end of file
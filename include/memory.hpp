@@ -0,0 +1,151 @@
+#ifndef RT_MEMORY_HPP
+#define RT_MEMORY_HPP
+
+#include "stats.hpp"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Bytes used by the objects of a scene, added up by walking it. Every object is counted once,
+// however many others share it. Vectors count their elements, not their spare capacity.
+namespace memory {
+  enum class Category {
+    triangles,
+    spheres,
+    quads,
+    bvh_nodes,
+    // translations, rotations and animated objects
+    instances,
+    media,
+    materials,
+    // with their texels
+    textures,
+    // the reference counts of the objects held by std::shared_ptr
+    control_blocks,
+    framebuffer,
+    // the mip levels of the textures loaded on first access, held at the end of the render
+    texture_cache,
+    count,
+  };
+
+  constexpr auto category_names = std::array{"triangles", "spheres", "quads", "bvh_nodes", "instances", "media",
+                                             "materials", "textures", "control_blocks", "framebuffer",
+                                             "texture_cache"};
+
+  // what std::make_shared allocates next to each object: a vtable pointer and two counts
+  constexpr auto control_block_bytes = sizeof(void*) + 2 * sizeof(int);
+
+  struct Usage {
+    std::uint64_t count{};
+    std::uint64_t bytes{};
+  };
+
+  // The primitives drawn with a material. A mesh has one material per group of faces.
+  struct MaterialUsage {
+    std::string type{};
+    Usage primitives{};
+  };
+
+  class Account final {
+  public:
+    // True the first time a shared object is seen, which counts its control block
+    auto visit(const void* object) -> bool {
+      if (!m_visited.insert(object).second) {
+        return false;
+      }
+      add(Category::control_blocks, control_block_bytes);
+      return true;
+    }
+
+    auto add(Category category, std::uint64_t bytes, std::uint64_t count = 1u) -> void {
+      auto& usage = m_usages[static_cast<std::size_t>(category)];
+      usage.count += count;
+      usage.bytes += bytes;
+    }
+
+    // A triangle, sphere or quad drawn with the material
+    auto add_primitive(Category category, std::uint64_t bytes, const void* material) -> void {
+      add(category, bytes);
+      auto& usage = material_usage(material).primitives;
+      ++usage.count;
+      usage.bytes += bytes;
+    }
+
+    auto set_material_type(const void* material, std::string type) -> void {
+      material_usage(material).type = std::move(type);
+    }
+
+    auto usage(Category category) const -> const Usage& {
+      return m_usages[static_cast<std::size_t>(category)];
+    }
+
+    auto total_bytes() const -> std::uint64_t {
+      auto bytes = std::uint64_t{};
+      for (const auto& usage : m_usages) {
+        bytes += usage.bytes;
+      }
+      return bytes;
+    }
+
+    // In the order the materials were first seen
+    auto materials() const -> const std::vector<MaterialUsage>& {
+      return m_materials;
+    }
+
+  private:
+    std::unordered_set<const void*> m_visited{};
+    std::array<Usage, static_cast<std::size_t>(Category::count)> m_usages{};
+    std::map<const void*, std::size_t> m_material_indices{};
+    std::vector<MaterialUsage> m_materials{};
+
+    auto material_usage(const void* material) -> MaterialUsage& {
+      auto [it, inserted] = m_material_indices.try_emplace(material, m_materials.size());
+      if (inserted) {
+        m_materials.push_back(MaterialUsage{});
+      }
+      return m_materials[it->second];
+    }
+  };
+
+  // Writes the usage of every category and material, and the peak resident set size after
+  // the scene was built and at the end
+  auto write_report(const std::string& path, const Account& account, std::uint64_t scene_peak_bytes) -> bool {
+    auto file = std::ofstream{path};
+    if (!file) {
+      std::cerr << "[ERROR] Failed to open " << path << "\n";
+      return false;
+    }
+
+    file << "{\n  \"categories\": {\n";
+    for (auto category = 0uz; category < category_names.size(); ++category) {
+      const auto& usage = account.usage(static_cast<Category>(category));
+      file << "    \"" << category_names[category] << "\": {\"count\": " << usage.count << ", \"bytes\": " << usage.bytes
+           << "}" << (category + 1 < category_names.size() ? "," : "") << "\n";
+    }
+    file << "  },\n";
+
+    file << "  \"materials\": [\n";
+    const auto& materials = account.materials();
+    for (auto i = 0uz; i < materials.size(); ++i) {
+      file << "    {\"index\": " << i << ", \"type\": \"" << materials[i].type << "\", \"primitives\": "
+           << materials[i].primitives.count << ", \"bytes\": " << materials[i].primitives.bytes << "}"
+           << (i + 1 < materials.size() ? "," : "") << "\n";
+    }
+    file << "  ],\n";
+
+    file << "  \"total_bytes\": " << account.total_bytes() << ",\n";
+    file << "  \"scene_peak_memory_bytes\": " << scene_peak_bytes << ",\n";
+    file << "  \"peak_memory_bytes\": " << stats::peak_memory_bytes() << "\n";
+    file << "}\n";
+
+    return static_cast<bool>(file);
+  }
+}
+
+#endif
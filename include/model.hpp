@@ -4,6 +4,8 @@
 #include "triangle.hpp"
 #include "material.hpp"
 #include "image.hpp"
+#include "stats.hpp"
+#include "tracing.hpp"
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
@@ -37,6 +39,7 @@ auto get_directory(const std::string& file_path) -> std::string
 using MaterialLib = std::map<std::string, std::shared_ptr<Material>>;
 auto import_mtllib(const std::string& mtllib_path) -> std::optional<MaterialLib>
 {
+  auto scope = tracing::ScopedTrace{"import_mtllib"};
   auto file = std::ifstream{ mtllib_path };
   if (!file) {
     std::cerr << "Could not open the file " << mtllib_path << '\n';
@@ -96,9 +99,14 @@ auto import_mtllib(const std::string& mtllib_path) -> std::optional<MaterialLib>
             std::cerr << "Could not parse the diffuse map name on line: " << line << '\n';
             return {};
           }
-          auto image = load_image(get_directory(mtllib_path) + texture_name);
-          if (!image) return {};
-          auto texture = std::make_shared<ImageTexture>(std::move(*image));
+          // only the size is read, the image is decoded when it is first looked up
+          auto texture_path = get_directory(mtllib_path) + texture_name;
+          auto size = get_image_size(texture_path);
+          if (!size) {
+            std::cerr << "Could not read the texture " << texture_path << '\n';
+            return {};
+          }
+          auto texture = std::make_shared<LazyImageTexture>(texture_path, size->first, size->second);
           auto material = std::make_shared<Lambertian>(texture);
           output.insert(std::pair{ std::move(material_name), material });
           found_material = true;
@@ -121,6 +129,7 @@ auto import_mtllib(const std::string& mtllib_path) -> std::optional<MaterialLib>
 
 auto import_model(const std::string& obj_path, float in_scale = 1.0f) -> std::optional<Model>
 {
+  auto phase = stats::ScopedPhase{stats::Phase::import};
   auto file = std::ifstream{ obj_path };
   if (!file) {
     std::cerr << "Could not open the file: " << obj_path << '\n';
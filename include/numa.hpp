@@ -0,0 +1,233 @@
+#ifndef RT_NUMA_HPP
+#define RT_NUMA_HPP
+
+#include "hittable.hpp"
+#include "framebuffer.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Placement of the render threads, and of what they read and write, on the NUMA nodes of the
+// machine. Linux places a page on the node of the thread that first writes it, so every buffer
+// is first written by the threads that use it. The nodes are read from sysfs. Elsewhere the
+// machine is a single node and threads are not pinned.
+namespace numa {
+  struct Topology {
+    // the CPUs of each node that the process may run on, nodes without any are left out
+    std::vector<std::vector<int>> node_cpus{};
+  };
+
+  // Parses a list like 0-3,8-11
+  auto parse_cpu_list(std::string_view text) -> std::vector<int> {
+    auto cpus = std::vector<int>{};
+    while (!text.empty()) {
+      auto comma = text.find(',');
+      auto range = text.substr(0, comma);
+      auto first = 0;
+      auto last = 0;
+      auto dash = range.find('-');
+      auto [end, error] = std::from_chars(range.data(), range.data() + std::min(dash, range.size()), first);
+      if (error != std::errc{}) {
+        return {};
+      }
+      last = first;
+      if (dash != std::string_view::npos && std::from_chars(range.data() + dash + 1, range.data() + range.size(), last).ec != std::errc{}) {
+        return {};
+      }
+      for (auto cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+      text.remove_prefix(comma == std::string_view::npos ? text.size() : comma + 1);
+    }
+    return cpus;
+  }
+
+  auto read_topology() -> Topology {
+    auto topology = Topology{};
+#if defined(__linux__)
+    auto allowed = cpu_set_t{};
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      return topology;
+    }
+
+    for (auto node = 0;; ++node) {
+      auto file = std::ifstream{"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"};
+      auto line = std::string{};
+      if (!file || !std::getline(file, line)) {
+        break;
+      }
+      auto cpus = parse_cpu_list(line);
+      std::erase_if(cpus, [&](int cpu) { return cpu >= CPU_SETSIZE || !CPU_ISSET(static_cast<std::size_t>(cpu), &allowed); });
+      if (!cpus.empty()) {
+        topology.node_cpus.push_back(std::move(cpus));
+      }
+    }
+
+    // without the sysfs nodes, every allowed CPU is on one node
+    if (topology.node_cpus.empty()) {
+      auto cpus = std::vector<int>{};
+      for (auto cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(static_cast<std::size_t>(cpu), &allowed)) {
+          cpus.push_back(cpu);
+        }
+      }
+      topology.node_cpus.push_back(std::move(cpus));
+    }
+#endif
+    return topology;
+  }
+
+  auto topology() -> const Topology& {
+    static const auto topology = read_topology();
+    return topology;
+  }
+
+  auto node_count() -> unsigned {
+    return std::max(static_cast<unsigned>(topology().node_cpus.size()), 1u);
+  }
+
+  // The node the calling thread was pinned to, and whether it is the first thread pinned there
+  thread_local auto current_node = 0u;
+  thread_local auto first_on_node = true;
+
+  // Nodes that have render threads, the first active_nodes ones
+  auto active_nodes = 1u;
+
+  auto pin_to_cpus(const std::vector<int>& cpus) -> bool {
+#if defined(__linux__)
+    auto set = cpu_set_t{};
+    CPU_ZERO(&set);
+    for (auto cpu : cpus) {
+      CPU_SET(static_cast<std::size_t>(cpu), &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    static_cast<void>(cpus);
+    return false;
+#endif
+  }
+
+  // Pins every OpenMP thread to a CPU, filling a node before going to the next one, so that
+  // the threads of a node share its memory and caches
+  auto pin_threads() -> void {
+    auto cpus = std::vector<std::pair<int, unsigned>>{};
+    for (auto node = 0u; node < topology().node_cpus.size(); ++node) {
+      for (auto cpu : topology().node_cpus[node]) {
+        cpus.emplace_back(cpu, node);
+      }
+    }
+    if (cpus.empty()) {
+      return;
+    }
+
+    auto last_node = 0u;
+    #pragma omp parallel reduction(max : last_node)
+    {
+#ifdef _OPENMP
+      auto thread = static_cast<std::size_t>(omp_get_thread_num());
+      auto threads = static_cast<std::size_t>(omp_get_num_threads());
+#else
+      auto thread = 0uz;
+      auto threads = 1uz;
+#endif
+      // with more threads than CPUs, every node gets its share of the extra threads
+      auto cpu_of = [&](std::size_t i) {
+        return cpus[threads <= cpus.size() ? i : i * cpus.size() / threads];
+      };
+      auto [cpu, node] = cpu_of(thread);
+      if (!pin_to_cpus({cpu})) {
+        #pragma omp critical
+        std::cerr << "[WARNING] Could not pin a thread to CPU " << cpu << "\n";
+      }
+      current_node = node;
+      first_on_node = thread == 0 || cpu_of(thread - 1).second != node;
+      last_node = std::max(last_node, node);
+    }
+    active_nodes = last_node + 1;
+  }
+
+  // The node whose threads render and first write the row
+  auto row_node(unsigned y, unsigned height) -> unsigned {
+    return static_cast<unsigned>(std::uint64_t{y} * active_nodes / std::max(height, 1u));
+  }
+
+  // Allocates the framebuffer and has a thread of each node clear the rows of the node
+  auto make_framebuffer(unsigned width, unsigned height) -> Framebuffer {
+    auto framebuffer = Framebuffer{width, height, Framebuffer::Unwritten{}};
+    #pragma omp parallel
+    {
+      if (first_on_node) {
+        auto node = current_node;
+        auto y0 = static_cast<unsigned>(std::uint64_t{height} * node / active_nodes);
+        auto y1 = static_cast<unsigned>(std::uint64_t{height} * (node + 1) / active_nodes);
+        framebuffer.clear_rows(y0, y1);
+      }
+    }
+    return framebuffer;
+  }
+
+  // Copies of the scene, one built on each node
+  auto replicas = std::vector<Hittables>{};
+  auto replicated = static_cast<const Hittable*>(nullptr);
+
+  // Builds a copy of the scene on every node, each from a thread pinned to the node so that
+  // the copy is placed there. Returns false if a copy could not be built.
+  auto replicate(const Hittables& original, const std::function<std::optional<Hittables>()>& build) -> bool {
+    replicas.clear();
+    replicated = nullptr;
+    if (node_count() < 2 || original.empty()) {
+      return true;
+    }
+
+    replicas.resize(node_count());
+    auto built = std::vector<char>(node_count());
+    auto threads = std::vector<std::thread>{};
+    for (auto node = 0u; node < node_count(); ++node) {
+      threads.emplace_back([&, node] {
+        pin_to_cpus(topology().node_cpus[node]);
+        auto hittables = build();
+        if (hittables) {
+          replicas[node] = std::move(*hittables);
+          built[node] = true;
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    if (std::ranges::find(built, char{0}) != built.end()) {
+      replicas.clear();
+      return false;
+    }
+    replicated = original.front().get();
+    return true;
+  }
+
+  // The copy of the scene on the node of the calling thread, or the scene itself when it was not replicated
+  auto local_hittables(const Hittables& hittables) -> const Hittables& {
+    if (replicated == nullptr || hittables.empty() || hittables.front().get() != replicated) {
+      return hittables;
+    }
+    return replicas[current_node];
+  }
+}
+
+#endif
@@ -1,7 +1,10 @@
 #ifndef RT_PPM_HPP
 #define RT_PPM_HPP
 
+#include "math.hpp"
+
 #include <glm/vec3.hpp>
+#include <glm/common.hpp>
 
 #include <vector>
 #include <fstream>
@@ -9,7 +12,7 @@
 #include <string>
 
 auto linear_to_gamma(float linear) -> float {
-  return std::pow(linear, 1.0f / 2.2f);
+  return math::pow(linear, 1.0f / 2.2f);
 }
 
 class Ppm final {
@@ -32,9 +35,10 @@ public:
     auto g = glm::clamp(linear_to_gamma(color.g), 0.0f, 0.999f);
     auto b = glm::clamp(linear_to_gamma(color.b), 0.0f, 0.999f);
 
-    m_file << static_cast<char>(r * 256.0f)
-           << static_cast<char>(g * 256.0f)
-           << static_cast<char>(b * 256.0f);
+    // through unsigned char, as values above 127 do not fit in a signed char
+    m_file << static_cast<char>(static_cast<unsigned char>(r * 256.0f))
+           << static_cast<char>(static_cast<unsigned char>(g * 256.0f))
+           << static_cast<char>(static_cast<unsigned char>(b * 256.0f));
   }
 
   auto width() const -> unsigned { return m_width; }
@@ -2,10 +2,12 @@
 #define RT_QUAD_HPP
 
 #include "hittable.hpp"
+#include "material.hpp"
 #include "random.hpp"
 
 #include <glm/geometric.hpp>
 
+#include <cmath>
 #include <memory>
 #include <optional>
 #include <iostream>
@@ -19,6 +21,7 @@ public:
     , m_qxr{glm::cross(m_q, m_r)}
     , m_normal{glm::normalize(m_qxr)}
     , m_material{material}
+    , m_texture_scale{1.0f / std::sqrt(glm::length(m_qxr))}
   {
     set_bounding_box();
   }
@@ -33,6 +36,17 @@ public:
     return m_bounding_box;
   }
 
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      account.add_primitive(memory::Category::quads, sizeof(*this), m_material.get());
+      m_material->account(account);
+    }
+  }
+
+  auto add_features(SceneFeatures& features) const -> void override {
+    features.lights = features.lights || m_material->emits_light();
+  }
+
   virtual auto hit(const Ray& ray, float min_distance, float max_distance) const -> std::optional<HitRecord> override {
     // o + dt = p + uq + vr
     // PO = matrix(q, r, -d) * vector(u, v, t)
@@ -66,7 +80,7 @@ public:
 
     auto front_face = glm::dot(ray.direction(), m_normal) < 0.0f;
 
-    return HitRecord{t, front_face, ray.at(t), front_face ? m_normal : -m_normal, m_material, glm::vec2{u, v}};
+    return HitRecord{t, front_face, ray.at(t), front_face ? m_normal : -m_normal, m_material.get(), glm::vec2{u, v}, m_texture_scale};
   }
 
 private:
@@ -76,6 +90,8 @@ private:
   glm::vec3 m_qxr{};
   glm::vec3 m_normal{};
   std::shared_ptr<Material> m_material{};
+  // the texture covers the quad once
+  float m_texture_scale{};
   Aabb m_bounding_box{};
 };
 
@@ -1,35 +1,78 @@
 #ifndef RT_RANDOM_HPP
 #define RT_RANDOM_HPP
 
+#include "math.hpp"
+
 #include <glm/vec3.hpp>
 #include <glm/ext/scalar_constants.hpp>
 
-#include <random>
-#include <chrono>
 #include <cmath>
+#include <cstdint>
 
+// Counter based generation: every value is a hash of a key, a counter and the seed,
+// so it does not depend on which thread draws it or on what was drawn before.
 namespace prng {
-  thread_local auto rd = std::random_device{};
-  thread_local auto time = std::chrono::steady_clock::now().time_since_epoch().count();
-  thread_local auto seed_seq = std::seed_seq{
-    static_cast<std::seed_seq::result_type>(time), rd(), rd(), rd(), rd(), rd(), rd(), rd()};
-  thread_local auto mt = std::mt19937{seed_seq};
+  // PCG output permutation: a cheap, well mixed 32 bit hash
+  auto hash(std::uint32_t value) -> std::uint32_t {
+    auto state = value * 747796405u + 2891336453u;
+    auto word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+  }
+
+  template <typename... Ts>
+  auto hash(std::uint32_t first, std::uint32_t second, Ts... rest) -> std::uint32_t {
+    return hash(hash(first) ^ second, rest...);
+  }
+
+  // SplitMix64 finalizer
+  auto mix(std::uint64_t value) -> std::uint64_t {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9u;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebu;
+    return value ^ (value >> 31);
+  }
+
+  auto get_bits(std::uint64_t key, std::uint64_t counter, std::uint32_t seed) -> std::uint32_t {
+    return static_cast<std::uint32_t>(mix(key ^ mix(counter + mix(seed))) >> 32);
+  }
 
+  // Uniform in [0, 1)
+  auto to_unit_float(std::uint32_t bits) -> float {
+    return static_cast<float>(bits >> 8) * 0x1p-24f;
+  }
+
+  // The sequential stream below is for code that draws on a single thread, like scene
+  // construction: it is reproducible for a given seed, but each thread starts it over
+  auto seed = std::uint32_t{};
+  thread_local auto counter = std::uint64_t{};
+
+  auto set_seed(std::uint32_t value) -> void {
+    seed = value;
+    counter = 0u;
+  }
+
+  auto next_bits() -> std::uint32_t {
+    return get_bits(~std::uint64_t{}, counter++, seed);
+  }
+
+  // for ranges of up to 2^32 values
   template <typename T>
-	T get_int(T min, T max) {
-		return std::uniform_int_distribution<T>{min, max}(mt);
-	}
+  T get_int(T min, T max) {
+    auto range = static_cast<std::uint64_t>(max - min) + 1u;
+    auto offset = (static_cast<std::uint64_t>(next_bits()) * range) >> 32;
+    return static_cast<T>(min + static_cast<T>(offset));
+  }
 
   template <typename T>
   T get_real(T min, T max) {
-    return std::uniform_real_distribution<T>{min, max}(mt);
+    return min + (max - min) * static_cast<T>(to_unit_float(next_bits()));
   }
 
   auto get_unit_vector() -> glm::vec3 {
     auto a = get_real(0.0f, 2.0f * glm::pi<float>());
     auto z = get_real(-1.0f, 1.0f);
     auto r = std::sqrt(1.0f - z * z);
-    return glm::vec3{r * std::cos(a), r * std::sin(a), z};
+    auto cos_sin = math::cos_sin(a);
+    return glm::vec3{r * cos_sin.x, r * cos_sin.y, z};
   }
 
   auto get_hemisphere_vector(const glm::vec3& normal) -> glm::vec3 {
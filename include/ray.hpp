@@ -3,14 +3,26 @@
 
 #include <glm/vec3.hpp>
 
+// The footprint of a ray, as a cone of the given width at its origin that widens by spread per
+// unit of distance. It chooses the level of detail of textures.
+struct RayCone {
+  float width{};
+  float spread{};
+
+  auto at(float distance) const -> float {
+    return width + spread * distance;
+  }
+};
+
 class Ray final {
 public:
   Ray() = default;
 
-  Ray(const glm::vec3& origin, const glm::vec3& direction, float time = 0.0f)
+  Ray(const glm::vec3& origin, const glm::vec3& direction, float time = 0.0f, const RayCone& cone = {})
     : m_origin{origin}
     , m_direction{direction}
-    , m_time{time} {
+    , m_time{time}
+    , m_cone{cone} {
   }
 
   auto origin() const -> const glm::vec3& {
@@ -25,6 +37,10 @@ public:
     return m_time;
   }
 
+  auto cone() const -> const RayCone& {
+    return m_cone;
+  }
+
   auto at(float t) const -> glm::vec3 {
     return m_origin + t * m_direction;
   }
@@ -33,6 +49,7 @@ private:
   glm::vec3 m_origin{};
   glm::vec3 m_direction{};
   float m_time{};
+  RayCone m_cone{};
 };
 
 #endif
\ No newline at end of file
@@ -6,7 +6,18 @@
 #include "timer.hpp"
 #include "random.hpp"
 #include "material.hpp"
+#include "camera.hpp"
+#include "stream.hpp"
+#include "sampler.hpp"
+#include "framebuffer.hpp"
+#include "checkpoint.hpp"
+#include "denoiser.hpp"
+#include "stats.hpp"
+#include "counters.hpp"
+#include "numa.hpp"
+#include "tracing.hpp"
 
+#include <glm/vec2.hpp>
 #include <glm/geometric.hpp>
 #include <glm/ext/scalar_constants.hpp>
 
@@ -14,40 +25,73 @@
 #include <memory>
 #include <vector>
 #include <cmath>
+#include <chrono>
 #include <optional>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <array>
+#include <functional>
+#include <atomic>
+#include <utility>
 
 constexpr auto g_max_float = std::numeric_limits<float>::max();
 
-auto trace(const Ray& ray, const Hittables& hittables) -> std::optional<HitRecord> {
-  auto closest_hit_record = HitRecord{g_max_float};
+// The features the render kernels handle. Every combination is compiled on its own, and a
+// frame is rendered by the one without the features it does not use.
+struct KernelFeatures {
+  bool defocus_blur{true};
+  bool motion_blur{true};
+  bool media{true};
+  bool lights{true};
+};
+
+constexpr auto g_kernel_count = 16u;
+
+constexpr auto get_kernel_features(unsigned index) -> KernelFeatures {
+  return KernelFeatures{(index & 1u) != 0, (index & 2u) != 0, (index & 4u) != 0, (index & 8u) != 0};
+}
+
+constexpr auto get_kernel_index(const KernelFeatures& features) -> unsigned {
+  return (features.defocus_blur ? 1u : 0u) | (features.motion_blur ? 2u : 0u) | (features.media ? 4u : 0u) | (features.lights ? 8u : 0u);
+}
+
+auto trace(const Ray& ray, const Hittables& hittables, float max_distance = g_max_float) -> std::optional<HitRecord> {
+  auto closest_hit_record = HitRecord{max_distance};
 
   for (const auto& hittable : hittables) {
-    auto hit_record = hittable->hit(ray, 0.0f, g_max_float);
+    auto hit_record = hittable->hit(ray, 0.0f, max_distance);
     if (hit_record && hit_record->distance < closest_hit_record.distance) {
       closest_hit_record = *hit_record;
     }
   }
 
-  if (closest_hit_record.distance == g_max_float) {
+  if (closest_hit_record.distance == max_distance) {
     return {};
   }
 
   return closest_hit_record;
 }
 
-auto ray_cast(const Ray& ray, unsigned depth, const glm::vec3& background_color, const Hittables& hittables) -> glm::vec3 {
+// Without Lights, no material emits light, so it is not checked
+template <bool Lights = true>
+auto ray_cast(const Ray& ray, unsigned depth, const glm::vec3& background_color, const Hittables& hittables, unsigned bounce = 0) -> glm::vec3 {
   if (depth == 0) {
     return glm::vec3{0.0f};
   }
 
+  sampling::current().start_bounce(bounce);
+
+  stats::count_rays(bounce == 0 ? stats::RayType::camera : stats::RayType::indirect, bounce);
   auto hit_record = trace(ray, hittables);
   if (hit_record) {
-    auto scatter_data = hit_record->material->scatter(ray, *hit_record);
+    const auto& material = *hit_record->material;
+    if (Lights && material.emits_light()) {
+      return material.emitted(ray, *hit_record);
+    }
+    auto scatter_data = material.scatter(ray, *hit_record);
     if (scatter_data) {
-      if (!near_zero(scatter_data->emission)) {
-        return scatter_data->emission;
-      }
-      return scatter_data->attenuation * ray_cast(scatter_data->scattered, depth - 1, background_color, hittables);
+      return scatter_data->attenuation * ray_cast<Lights>(scatter_data->scattered, depth - 1, background_color, hittables, bounce + 1);
     }
     return glm::vec3{0.0f};
   }
@@ -55,6 +99,37 @@ auto ray_cast(const Ray& ray, unsigned depth, const glm::vec3& background_color,
   return background_color;
 }
 
+// Fraction of the cosine weighted directions above the hit point that do not hit anything
+// closer than radius
+auto ambient_occlusion(const Ray& ray, float radius, const Hittables& hittables) -> glm::vec3 {
+  stats::count_rays(stats::RayType::camera, 0u);
+  auto hit_record = trace(ray, hittables);
+  if (!hit_record) {
+    return glm::vec3{1.0f};
+  }
+
+  auto& sampler = sampling::current();
+  sampler.start_bounce(1u);
+  auto direction = hit_record->normal + sampler.get_unit_vector();
+  if (near_zero(direction)) {
+    direction = hit_record->normal;
+  }
+  auto occlusion_ray = Ray{hit_record->point + hit_record->normal * g_bias, glm::normalize(direction), ray.time()};
+  stats::count_rays(stats::RayType::occlusion, 1u);
+  return trace(occlusion_ray, hittables, radius) ? glm::vec3{0.0f} : glm::vec3{1.0f};
+}
+
+// What a path tracer shows, or a faster view of the scene
+enum class Integrator {
+  path,
+  ambient_occlusion,
+  albedo,
+  normals,
+  depth,
+  // light reaching the camera after at most one bounce
+  direct,
+};
+
 struct RenderOptions {
   float fov{0.9f};
   unsigned num_samples{};
@@ -64,74 +139,587 @@ struct RenderOptions {
   float focus_distance{1.0f};
   float defocus_angle{};
   glm::vec3 background_color{0.5f, 0.7f, 1.0f};
+  // trace tiles of coherent rays together instead of one ray at a time
+  bool stream_traversal{};
+  SamplerType sampler{SamplerType::sobol};
+  std::uint32_t seed{};
+  // name of the scene, so that checkpoints of another scene are not resumed
+  std::string scene{};
+  // periodically save the framebuffer to checkpoint_path, and continue from it when resume is set
+  std::string checkpoint_path{};
+  float checkpoint_interval{600.0f};
+  bool resume{};
+  // the part of the image this process renders when a frame is split between processes:
+  // every tile_count-th tile starting at tile_index, and the samples in [sample_begin, sample_end)
+  unsigned tile_index{};
+  unsigned tile_count{1};
+  unsigned sample_begin{};
+  unsigned sample_end{std::numeric_limits<unsigned>::max()};
+  // when positive, stop after the last pass that fits in this many seconds, num_samples is then a limit
+  float time_budget{};
+  // only trace the pixels in this window, the image written is then the window
+  std::optional<Region> crop{};
+  Integrator integrator{Integrator::path};
+  float ao_radius{1.0f};
+  // take the first sample of every 8th, then every 4th pixel of each row and column before
+  // the others, so that a low resolution image can be shown quickly
+  bool preview{};
+  // pin the render threads, and have the threads of each NUMA node render and first write
+  // their own rows of the framebuffer, see numa.hpp
+  bool numa{};
 };
 
-auto render(Ppm& ppm, const RenderOptions& options, const Hittables& hittables) -> void {
-  auto widthf = static_cast<float>(ppm.width());
-  auto heightf = static_cast<float>(ppm.height());
-  auto aspect_ratio = widthf / heightf;
+// Radiance, or the quantity shown by the integrator, along a camera ray
+template <bool Lights = true>
+auto integrate(const Ray& ray, const RenderOptions& options, const Hittables& hittables) -> glm::vec3 {
+  switch (options.integrator) {
+    case Integrator::path:
+      return ray_cast<Lights>(ray, options.max_depth, options.background_color, hittables);
+    case Integrator::direct:
+      return ray_cast<Lights>(ray, std::min(options.max_depth, 2u), options.background_color, hittables);
+    case Integrator::ambient_occlusion:
+      return ambient_occlusion(ray, options.ao_radius, hittables);
+    default:
+      break;
+  }
 
-  auto w = glm::normalize(options.look_from - options.look_at);
-  auto u = glm::normalize(glm::cross(glm::vec3{0.0f, 1.0f, 0.0f}, w));
-  auto v = glm::cross(w, u);
+  stats::count_rays(stats::RayType::camera, 0u);
+  auto hit_record = trace(ray, hittables);
+  if (!hit_record) {
+    return options.integrator == Integrator::albedo ? options.background_color : glm::vec3{0.0f};
+  }
 
-  auto viewport_height = 2.0f * options.focus_distance * std::tan(options.fov / 2.0f);
-  auto viewport_width = aspect_ratio * viewport_height;
+  switch (options.integrator) {
+    case Integrator::albedo:
+      return hit_record->material->albedo(ray, *hit_record);
+    case Integrator::normals:
+      return hit_record->normal * 0.5f + 0.5f;
+    default: {
+      // 1 at the camera, 0.5 at the distance of the point looked at, and 0 far away
+      auto distance = hit_record->distance * glm::length(ray.direction());
+      auto half_distance = std::max(glm::length(options.look_at - options.look_from), 1e-4f);
+      return glm::vec3{half_distance / (half_distance + distance)};
+    }
+  }
+}
 
-  auto du = u * (viewport_width / widthf);
-  auto dv = -v * (viewport_height / heightf);
-  auto start = options.look_from - 0.5f * viewport_width * u + 0.5f * viewport_height * v - options.focus_distance * w + 0.5f * (du + dv);
+// Resolutions of the preview passes, as the distance between two traced pixels
+constexpr auto g_preview_strides = std::array{8u, 4u};
 
-  auto defocus_radius = options.focus_distance * std::tan(options.defocus_angle / 2);
+auto get_region(const RenderOptions& options, unsigned width, unsigned height) -> Region {
+  if (!options.crop) {
+    return Region{0u, 0u, width, height};
+  }
+  auto x1 = std::min(options.crop->x1, width);
+  auto y1 = std::min(options.crop->y1, height);
+  return Region{std::min(options.crop->x0, x1), std::min(options.crop->y0, y1), x1, y1};
+}
 
-  auto sqrt_samples = static_cast<unsigned>(std::sqrt(static_cast<float>(options.num_samples)));
-  auto inv_sqrt_samples = 1.0f / static_cast<float>(sqrt_samples);
+constexpr auto g_tile_size = 16u;
+// samples taken by every pixel between two chances to save a checkpoint
+constexpr auto g_pass_samples = 16u;
 
-  auto color_scale = 1.0f / static_cast<float>(sqrt_samples * sqrt_samples); 
+// The lens and time dimensions are only drawn when they are used. They stay reserved, so
+// the dimensions drawn afterwards are the same either way.
+template <KernelFeatures Features = KernelFeatures{}>
+auto get_camera_ray(const Camera& camera, Sampler& sampler, unsigned x, unsigned y, unsigned sample_index) -> Ray {
+  sampler.start_pixel_sample(x, y, sample_index);
+  auto pixel_offset = sampler.get_2d() - 0.5f;
+  auto lens_sample = glm::vec2{};
+  if constexpr (Features.defocus_blur) {
+    lens_sample = sampler.get_2d();
+  }
+  else {
+    sampler.skip(2u);
+  }
+  auto time = 0.0f;
+  if constexpr (Features.motion_blur) {
+    time = sampler.get_1d();
+  }
+  else {
+    sampler.skip(1u);
+  }
+  return camera.get_ray<Features.defocus_blur>(x, y, pixel_offset, lens_sample, time);
+}
 
-  auto framebuffer = std::vector<glm::vec3>(ppm.width() * ppm.height());
- 
-  auto timer = Timer{};
+// The features of the camera and of the scene
+auto get_kernel_features(const Camera& camera, const Hittables& hittables) -> KernelFeatures {
+  auto scene = SceneFeatures{};
+  for (const auto& hittable : hittables) {
+    hittable->add_features(scene);
+  }
+  return KernelFeatures{camera.has_defocus_blur(), scene.motion_blur, scene.media, scene.lights};
+}
+
+struct PathState {
+  glm::vec3 throughput{1.0f};
+  unsigned pixel{};
+  SamplerState sampler_state{};
+};
+
+// Sample counts passed to the render functions are relative to framebuffer.sample_offset.
+// With a stride, only the pixels of every stride-th row and column of the tile are rendered.
+
+// Same result as ray_cast, but all the paths of a tile advance one bounce at a time:
+// primary rays are traced as a coherent bundle, and the scattered rays are reordered
+// by direction octant and origin, then traced as one bundle per octant.
+// Without Media, nothing draws samples while being hit, so the sampler states are not
+// passed through the traversal.
+template <KernelFeatures Features = KernelFeatures{}>
+auto render_tile_stream(Framebuffer& framebuffer, const Region& tile, unsigned stride, unsigned sample_end, const Camera& camera, const RenderOptions& options, const Hittables& hittables, const Aabb& bounds) -> void {
+  auto& sampler = sampling::current();
 
-  #pragma omp parallel for schedule(dynamic, 1)
-  for (auto y = 0u; y < ppm.height(); ++y) {
-    for (auto x = 0u; x < ppm.width(); ++x) {
-      auto color = glm::vec3{0.0f};
-      auto direction = start + 
-        static_cast<float>(x) * du + 
-        static_cast<float>(y) * dv;
-        
-      for (auto sample_y = 0u; sample_y < sqrt_samples; ++sample_y) {
-        for (auto sample_x = 0u; sample_x < sqrt_samples; ++sample_x) {
-          auto theta = prng::get_real(0.0f, 2.0f * glm::pi<float>());
-          auto r = prng::get_real(0.0f, 1.0f);
-          auto lens_offset = defocus_radius * r * (std::cos(theta) * u + std::sin(theta) * v);
-
-          auto sxf = static_cast<float>(sample_x);
-          auto syf = static_cast<float>(sample_y);
-          auto dir_offset = 
-            ((sxf + prng::get_real(0.0f, 1.0f)) * inv_sqrt_samples - 0.5f) * du + 
-            ((syf + prng::get_real(0.0f, 1.0f)) * inv_sqrt_samples - 0.5f) * dv;
-
-          auto origin = options.look_from + lens_offset;
-          auto ray = Ray{origin, direction + dir_offset - origin, prng::get_real(0.0f, 1.0f)};
-          color += ray_cast(ray, options.max_depth, options.background_color, hittables);
+  auto stream = RayStream{};
+  auto paths = std::vector<PathState>{};
+  auto next_rays = std::vector<Ray>{};
+  auto next_paths = std::vector<PathState>{};
+  auto keys = std::vector<std::uint32_t>{};
+  auto order = std::vector<unsigned>{};
+
+  auto sample_begin = sample_end;
+  for (auto y = tile.y0; y < tile.y1; y += stride) {
+    for (auto x = tile.x0; x < tile.x1; x += stride) {
+      sample_begin = std::min(sample_begin, framebuffer.sample_counts[y * framebuffer.width + x]);
+    }
+  }
+
+  for (auto sample = sample_begin; sample < sample_end; ++sample) {
+    stream.rays.clear();
+    paths.clear();
+    for (auto y = tile.y0; y < tile.y1; y += stride) {
+      for (auto x = tile.x0; x < tile.x1; x += stride) {
+        auto pixel = y * framebuffer.width + x;
+        if (framebuffer.sample_counts[pixel] > sample) {
+          continue;
+        }
+        stream.rays.push_back(get_camera_ray<Features>(camera, sampler, x, y, framebuffer.sample_offset + sample));
+        paths.push_back(PathState{glm::vec3{1.0f}, pixel, sampler.state()});
+      }
+    }
+
+    for (auto bounce = 0u; bounce < options.max_depth && !stream.rays.empty(); ++bounce) {
+      if constexpr (Features.media) {
+        stream.sampler_states.resize(paths.size());
+        for (auto i = 0u; i < paths.size(); ++i) {
+          sampler.set_state(paths[i].sampler_state);
+          sampler.start_bounce(bounce);
+          stream.sampler_states[i] = sampler.state();
         }
       }
 
-      framebuffer[y * ppm.width() + x] = color * color_scale;
+      stats::count_rays(bounce == 0 ? stats::RayType::camera : stats::RayType::indirect, bounce, stream.rays.size());
+      trace_stream(stream, hittables);
+
+      next_rays.clear();
+      next_paths.clear();
+      for (auto i = 0u; i < stream.rays.size(); ++i) {
+        const auto& path = paths[i];
+        const auto& hit_record = stream.hits[i];
+        if (!hit_record) {
+          framebuffer.accumulation[path.pixel] += path.throughput * options.background_color;
+          continue;
+        }
+
+        const auto& material = *hit_record->material;
+        if (Features.lights && material.emits_light()) {
+          framebuffer.accumulation[path.pixel] += path.throughput * material.emitted(stream.rays[i], *hit_record);
+          continue;
+        }
+
+        sampler.set_state(path.sampler_state);
+        sampler.start_bounce(bounce);
+        auto scatter_data = material.scatter(stream.rays[i], *hit_record);
+        if (!scatter_data) {
+          continue;
+        }
+        next_rays.push_back(scatter_data->scattered);
+        next_paths.push_back(PathState{path.throughput * scatter_data->attenuation, path.pixel, sampler.state()});
+      }
+
+      keys.resize(next_rays.size());
+      order.resize(next_rays.size());
+      for (auto i = 0u; i < next_rays.size(); ++i) {
+        keys[i] = get_sort_key(next_rays[i], bounds);
+        order[i] = i;
+      }
+      std::sort(order.begin(), order.end(), [&](auto a, auto b) { return keys[a] < keys[b]; });
+
+      stream.rays.resize(next_rays.size());
+      paths.resize(next_paths.size());
+      for (auto i = 0u; i < order.size(); ++i) {
+        stream.rays[i] = next_rays[order[i]];
+        paths[i] = next_paths[order[i]];
+      }
+    }
+  }
+
+  for (auto y = tile.y0; y < tile.y1; y += stride) {
+    for (auto x = tile.x0; x < tile.x1; x += stride) {
+      auto& sample_count = framebuffer.sample_counts[y * framebuffer.width + x];
+      sample_count = std::max(sample_count, sample_end);
     }
+  }
+}
 
-    if (y % 50 == 0) {
-      auto progress = static_cast<float>(y) / static_cast<float>(ppm.height());
-      std::cout << "Progress: " << progress * 100 << "% (" << timer.elapsed() / 1000 << "s)\n";
+template <KernelFeatures Features = KernelFeatures{}>
+auto render_tile(Framebuffer& framebuffer, const Region& tile, unsigned stride, unsigned sample_end, const Camera& camera, const RenderOptions& options, const Hittables& hittables) -> void {
+  auto& sampler = sampling::current();
+  for (auto y = tile.y0; y < tile.y1; y += stride) {
+    for (auto x = tile.x0; x < tile.x1; x += stride) {
+      auto pixel = y * framebuffer.width + x;
+      for (auto sample = framebuffer.sample_counts[pixel]; sample < sample_end; ++sample) {
+        auto ray = get_camera_ray<Features>(camera, sampler, x, y, framebuffer.sample_offset + sample);
+        framebuffer.accumulation[pixel] += integrate<Features.lights>(ray, options, hittables);
+      }
+      framebuffer.sample_counts[pixel] = std::max(framebuffer.sample_counts[pixel], sample_end);
     }
   }
-  std::cout << "Render time: " << timer.elapsed() / 1000 << "s\n";
+}
 
-  for (auto i = 0u; i < ppm.width() * ppm.height(); ++i) {
-    ppm.write_color(framebuffer[i]);
+template <std::size_t... Indices>
+constexpr auto make_tile_kernels(std::index_sequence<Indices...>) {
+  return std::array{&render_tile<get_kernel_features(Indices)>...};
+}
+
+template <std::size_t... Indices>
+constexpr auto make_stream_kernels(std::index_sequence<Indices...>) {
+  return std::array{&render_tile_stream<get_kernel_features(Indices)>...};
+}
+
+// The render kernels, indexed by get_kernel_index
+constexpr auto g_tile_kernels = make_tile_kernels(std::make_index_sequence<g_kernel_count>{});
+constexpr auto g_stream_kernels = make_stream_kernels(std::make_index_sequence<g_kernel_count>{});
+
+// Takes the samples of every pixel of the assigned tiles up to sample_end. Samples of a pixel are
+// always accumulated in the same order, so the result does not depend on how the work was split.
+// Tiles start at the corner of the crop window. Once cancelled is set or the deadline is past, the tiles
+// not started yet are skipped and their pixels keep their sample counts.
+// features must cover what the camera and the scene use, see get_kernel_features.
+auto render_pass(Framebuffer& framebuffer, unsigned sample_end, const Camera& camera, const RenderOptions& options, const Hittables& hittables,
+                 const KernelFeatures& features, unsigned stride = 1, const std::atomic<bool>* cancelled = nullptr,
+                 std::optional<std::chrono::steady_clock::time_point> deadline = {}) -> void {
+  auto region = get_region(options, framebuffer.width, framebuffer.height);
+  auto tiles_x = (region.width() + g_tile_size - 1) / g_tile_size;
+  auto tiles_y = (region.height() + g_tile_size - 1) / g_tile_size;
+  auto tile_count = std::max(options.tile_count, 1u);
+  auto assigned_tiles = (tiles_x * tiles_y + tile_count - 1 - options.tile_index) / tile_count;
+  auto scope = tracing::ScopedTrace{"pass", sample_end};
+
+  auto get_tile = [&](unsigned i) {
+    auto tile_index = options.tile_index + i * tile_count;
+    auto tile = Region{};
+    tile.x0 = region.x0 + (tile_index % tiles_x) * g_tile_size;
+    tile.y0 = region.y0 + (tile_index / tiles_x) * g_tile_size;
+    tile.x1 = std::min(tile.x0 + g_tile_size, region.x1);
+    tile.y1 = std::min(tile.y0 + g_tile_size, region.y1);
+    return tile;
+  };
+
+  // with NUMA placement, the threads of a node take the tiles of its rows first, and then
+  // help the other nodes
+  auto node_tiles = std::vector<std::vector<unsigned>>{};
+  if (options.numa) {
+    node_tiles.resize(numa::active_nodes);
+    for (auto i = 0u; i < assigned_tiles; ++i) {
+      node_tiles[numa::row_node(get_tile(i).y0, framebuffer.height)].push_back(i);
+    }
+  }
+  auto next_tiles = std::vector<std::atomic<unsigned>>(node_tiles.size());
+  auto kernel_index = get_kernel_index(features);
+
+  #pragma omp parallel
+  {
+    auto sampler = make_sampler(options.sampler, options.num_samples, options.seed);
+    sampling::bind(sampler.get());
+    const auto& local_hittables = options.numa ? numa::local_hittables(hittables) : hittables;
+    auto bounds = options.stream_traversal ? get_bounds(local_hittables) : Aabb{};
+
+    auto render_assigned_tile = [&](unsigned i) {
+      if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+        return;
+      }
+      if (deadline && std::chrono::steady_clock::now() >= *deadline) {
+        return;
+      }
+      auto tile_scope = tracing::ScopedTrace{"tile", options.tile_index + i * tile_count};
+      // counted per tile, so that the threads waiting at the end of the loop are not
+      auto counting = counters::Scope{counters::Section::render};
+      auto tile = get_tile(i);
+      // the stream renderer only does path tracing
+      if (options.stream_traversal && options.integrator == Integrator::path) {
+        g_stream_kernels[kernel_index](framebuffer, tile, stride, sample_end, camera, options, local_hittables, bounds);
+      }
+      else {
+        g_tile_kernels[kernel_index](framebuffer, tile, stride, sample_end, camera, options, local_hittables);
+      }
+    };
+
+    if (!options.numa) {
+      #pragma omp for schedule(dynamic, 1)
+      for (auto i = 0u; i < assigned_tiles; ++i) {
+        render_assigned_tile(i);
+      }
+    }
+    else {
+      for (auto k = 0u; k < node_tiles.size(); ++k) {
+        auto node = (numa::current_node + k) % static_cast<unsigned>(node_tiles.size());
+        for (auto next = next_tiles[node]++; next < node_tiles[node].size(); next = next_tiles[node]++) {
+          render_assigned_tile(node_tiles[node][next]);
+        }
+      }
+    }
+
+    sampling::bind(nullptr);
+  }
+}
+
+// FNV-1a of the bytes, the same in every build so that checkpoints can move between machines
+auto fnv1a(std::uint32_t hash, const void* data, std::size_t size) -> std::uint32_t {
+  auto bytes = static_cast<const unsigned char*>(data);
+  for (auto i = 0uz; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// Hash of the scene name and of the options that change the image but are not in the header
+auto get_scene_hash(const RenderOptions& options) -> std::uint32_t {
+  auto hash = fnv1a(2166136261u, options.scene.data(), options.scene.size());
+  auto values = std::array{
+    options.fov, options.focus_distance, options.defocus_angle, options.ao_radius,
+    options.look_from.x, options.look_from.y, options.look_from.z,
+    options.look_at.x, options.look_at.y, options.look_at.z,
+    options.background_color.r, options.background_color.g, options.background_color.b,
+  };
+  return fnv1a(hash, values.data(), values.size() * sizeof(float));
+}
+
+auto get_checkpoint_header(const RenderOptions& options, unsigned width, unsigned height) -> CheckpointHeader {
+  auto header = CheckpointHeader{};
+  header.width = width;
+  header.height = height;
+  header.num_samples = options.num_samples;
+  header.max_depth = options.max_depth;
+  header.sampler = static_cast<std::uint32_t>(options.sampler);
+  header.seed = options.seed;
+  header.integrator = static_cast<std::uint32_t>(options.integrator);
+  header.scene_hash = get_scene_hash(options);
+  auto crop = get_region(options, width, height);
+  header.crop_x0 = crop.x0;
+  header.crop_y0 = crop.y0;
+  header.crop_x1 = crop.x1;
+  header.crop_y1 = crop.y1;
+  header.tile_index = options.tile_index;
+  header.tile_count = std::max(options.tile_count, 1u);
+  header.sample_begin = std::min(options.sample_begin, options.num_samples);
+  header.sample_end = std::clamp(options.sample_end, header.sample_begin, options.num_samples);
+  return header;
+}
+
+auto make_camera(const RenderOptions& options, unsigned width, unsigned height) -> Camera {
+  return Camera{width, height, options.fov, options.look_from, options.look_at, options.focus_distance, options.defocus_angle};
+}
+
+// Samples per pixel of the feature buffers
+constexpr auto g_feature_samples = 16u;
+
+// Averages the first hit of the first samples of each pixel of the crop window. Only camera
+// rays are traced, so this costs a fraction of one render pass.
+auto render_features(unsigned width, unsigned height, const RenderOptions& options, const Hittables& hittables) -> FeatureBuffers {
+  auto scope = tracing::ScopedTrace{"features"};
+  auto camera = make_camera(options, width, height);
+  auto region = get_region(options, width, height);
+  auto num_samples = std::max(std::min(g_feature_samples, options.num_samples), 1u);
+  auto features = FeatureBuffers{width, height};
+
+  #pragma omp parallel
+  {
+    auto sampler = make_sampler(options.sampler, options.num_samples, options.seed);
+    sampling::bind(sampler.get());
+
+    #pragma omp for schedule(dynamic, 1)
+    for (auto y = region.y0; y < region.y1; ++y) {
+      for (auto x = region.x0; x < region.x1; ++x) {
+        auto pixel = y * width + x;
+        auto albedo = glm::vec3{0.0f};
+        auto normal = glm::vec3{0.0f};
+        auto depth = 0.0f;
+        for (auto sample = 0u; sample < num_samples; ++sample) {
+          auto ray = get_camera_ray(camera, *sampler, x, y, sample);
+          sampler->start_bounce(0u);
+          stats::count_rays(stats::RayType::feature, 0u);
+          auto hit_record = trace(ray, hittables);
+          if (!hit_record) {
+            albedo += glm::vec3{1.0f};
+            continue;
+          }
+          albedo += hit_record->material->albedo(ray, *hit_record);
+          normal += hit_record->normal;
+          depth += hit_record->distance * glm::length(ray.direction());
+        }
+        features.albedo[pixel] = albedo / static_cast<float>(num_samples);
+        features.normal[pixel] = normal / static_cast<float>(num_samples);
+        features.depth[pixel] = depth / static_cast<float>(num_samples);
+      }
+    }
+
+    sampling::bind(nullptr);
+  }
+
+  return features;
+}
+
+// Lets the caller follow a render and stop it
+struct RenderHooks {
+  // called with the framebuffer and the stride of each preview pass
+  std::function<void(const Framebuffer&, unsigned)> on_preview{};
+  // called with the fraction of the samples taken after each pass
+  std::function<void(float)> on_progress{};
+  // checked before each tile, render returns as soon as it is set
+  const std::atomic<bool>* cancelled{};
+};
+
+// Returns nothing if the render was to resume from a checkpoint that could not be read
+auto render(unsigned width, unsigned height, const RenderOptions& options, const Hittables& hittables,
+            const RenderHooks& hooks = {}) -> std::optional<Framebuffer> {
+  auto phase = stats::ScopedPhase{stats::Phase::render};
+  auto is_cancelled = [&] { return hooks.cancelled && hooks.cancelled->load(); };
+
+  auto camera = make_camera(options, width, height);
+  auto features = get_kernel_features(camera, hittables);
+
+  auto header = get_checkpoint_header(options, width, height);
+  auto num_samples = header.sample_end - header.sample_begin;
+
+  auto framebuffer = Framebuffer{};
+  if (options.numa) {
+    numa::pin_threads();
+    framebuffer = numa::make_framebuffer(width, height);
+  }
+  else {
+    framebuffer = Framebuffer{width, height};
+  }
+  framebuffer.sample_offset = header.sample_begin;
+  if (options.resume) {
+    // starting over would overwrite the checkpoint at the first interval
+    auto checkpoint = read_checkpoint(options.checkpoint_path, header);
+    if (!checkpoint) {
+      std::cerr << "[ERROR] Could not resume from " << options.checkpoint_path << "\n";
+      return {};
+    }
+    framebuffer = std::move(*checkpoint);
+    std::cout << "Resuming from " << options.checkpoint_path << "\n";
+  }
+
+  auto writer = std::optional<CheckpointWriter>{};
+  if (!options.checkpoint_path.empty()) {
+    writer.emplace(options.checkpoint_path, header);
+  }
+
+  auto timer = Timer{};
+  auto checkpoint_timer = Timer{};
+  // passes stop at the end of the time budget, even when the estimate of their length was wrong
+  auto deadline = std::optional<std::chrono::steady_clock::time_point>{};
+  if (options.time_budget > 0.0f) {
+    deadline = std::chrono::steady_clock::now()
+      + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>{options.time_budget});
+  }
+
+  // checkpoints are only saved between passes, where all the assigned pixels have the same
+  // count, and the pixels of the other tiles stay at 0. The last one, after a pass cut by the
+  // time budget, may have pixels with fewer samples, which a resumed render catches up first.
+  auto samples_done = *std::max_element(framebuffer.sample_counts.begin(), framebuffer.sample_counts.end());
+  // the samples of the preview passes are the first samples of the pixels, so the next pass
+  // only takes the ones that are missing
+  if (options.preview && samples_done == 0 && num_samples > 0) {
+    for (auto stride : g_preview_strides) {
+      render_pass(framebuffer, 1u, camera, options, hittables, features, stride, hooks.cancelled, deadline);
+      if (is_cancelled()) {
+        return framebuffer;
+      }
+      std::cout << "Preview 1/" << stride << " (" << timer.elapsed() / 1000 << "s)\n";
+      if (hooks.on_preview) {
+        hooks.on_preview(framebuffer, stride);
+      }
+    }
+  }
+
+  auto sample_time = 0.0;
+  while (samples_done < num_samples) {
+    auto pass_samples = g_pass_samples;
+    if (options.time_budget > 0.0f) {
+      // the first pass takes a single sample to measure how long one takes, the next ones
+      // take half of what is left of the budget, so that a pass longer than estimated
+      // usually still ends before the deadline and every pixel gets the same samples
+      auto time_left = options.time_budget * 1000.0 - timer.elapsed();
+      if (sample_time == 0.0) {
+        pass_samples = 1u;
+      }
+      else if (time_left < sample_time) {
+        std::cout << "Time budget reached\n";
+        break;
+      }
+      else {
+        pass_samples = static_cast<unsigned>(std::clamp(0.5 * time_left / sample_time, 1.0, static_cast<double>(g_pass_samples)));
+      }
+    }
+
+    auto pass_timer = Timer{};
+    auto pass_begin = samples_done;
+    samples_done = std::min(samples_done + pass_samples, num_samples);
+    render_pass(framebuffer, samples_done, camera, options, hittables, features, 1u, hooks.cancelled, deadline);
+    if (is_cancelled()) {
+      // the last checkpoint is kept, as the pixels of an unfinished pass have different counts
+      std::cout << "Cancelled\n";
+      return framebuffer;
+    }
+    if (deadline && std::chrono::steady_clock::now() >= *deadline) {
+      std::cout << "Time budget reached\n";
+      break;
+    }
+    sample_time = pass_timer.elapsed() / (samples_done - pass_begin);
+
+    auto progress = static_cast<float>(samples_done) / static_cast<float>(num_samples);
+    std::cout << "Progress: " << progress * 100 << "% (" << timer.elapsed() / 1000 << "s)\n";
+    if (hooks.on_progress) {
+      hooks.on_progress(progress);
+    }
+
+    if (writer && samples_done < num_samples && checkpoint_timer.elapsed() >= options.checkpoint_interval * 1000.0f) {
+      if (writer->save_async(framebuffer)) {
+        checkpoint_timer.reset();
+      }
+    }
+  }
+  std::cout << "Render time: " << timer.elapsed() / 1000 << "s (" << samples_done << " samples)\n";
+
+  // resuming a finished render then only writes the image again
+  if (writer) {
+    writer->wait();
+    write_checkpoint(options.checkpoint_path, header, framebuffer);
+  }
+
+  return framebuffer;
+}
+
+// Writes the region of the framebuffer. With a stride, each pixel takes the color of the
+// rendered pixel at the corner of its block, to show the result of a preview pass.
+auto write_image(Ppm& ppm, const Framebuffer& framebuffer, const Region& region, unsigned stride = 1) -> void {
+  for (auto y = region.y0; y < region.y1; ++y) {
+    for (auto x = region.x0; x < region.x1; ++x) {
+      auto block_x = region.x0 + (x - region.x0) / stride * stride;
+      auto block_y = region.y0 + (y - region.y0) / stride * stride;
+      ppm.write_color(framebuffer.color(block_y * framebuffer.width + block_x));
+    }
+  }
+}
+
+auto write_image(Ppm& ppm, const std::vector<glm::vec3>& colors, unsigned width, const Region& region) -> void {
+  for (auto y = region.y0; y < region.y1; ++y) {
+    for (auto x = region.x0; x < region.x1; ++x) {
+      ppm.write_color(colors[y * width + x]);
+    }
   }
 }
 
-#endif
\ No newline at end of file
+#endif
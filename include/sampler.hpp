@@ -0,0 +1,243 @@
+#ifndef RT_SAMPLER_HPP
+#define RT_SAMPLER_HPP
+
+#include "random.hpp"
+#include "math.hpp"
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/ext/scalar_constants.hpp>
+
+#include <memory>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+// Where a path is in its sample sequence, so that it can be suspended and resumed
+struct SamplerState {
+  unsigned x{};
+  unsigned y{};
+  unsigned sample_index{};
+  unsigned dimension{};
+  unsigned bounce{};
+};
+
+// Provides the sample values of one pixel sample, one dimension at a time.
+// The camera always uses the first dimensions, and each bounce then draws from
+// its own block of dimensions, so a given dimension feeds the same decision in
+// every path no matter how many values the previous bounces used.
+class Sampler {
+public:
+  virtual ~Sampler() = default;
+
+  static constexpr auto s_camera_dimensions = 5u;
+  static constexpr auto s_bounce_dimensions = 8u;
+  // the last dimension of each bounce block, which materials do not reach
+  static constexpr auto s_medium_dimension = s_bounce_dimensions - 1u;
+
+  virtual auto start_pixel_sample(unsigned x, unsigned y, unsigned sample_index) -> void {
+    m_state = SamplerState{x, y, sample_index, 0u, 0u};
+  }
+
+  auto start_bounce(unsigned bounce) -> void {
+    m_state.dimension = s_camera_dimensions + bounce * s_bounce_dimensions;
+    m_state.bounce = bounce;
+  }
+
+  // Leaves out the next dimensions, for values that are not needed
+  auto skip(unsigned dimensions) -> void {
+    m_state.dimension += dimensions;
+  }
+
+  auto state() const -> const SamplerState& {
+    return m_state;
+  }
+
+  auto set_state(const SamplerState& state) -> void {
+    start_pixel_sample(state.x, state.y, state.sample_index);
+    m_state.dimension = state.dimension;
+    m_state.bounce = state.bounce;
+  }
+
+  virtual auto get_1d() -> float = 0;
+  virtual auto get_2d() -> glm::vec2 = 0;
+
+  // A value for the free flight of a ray through a medium. It is read from the medium dimension
+  // of the bounce and the next draws do not move, so the values of a path are the same however
+  // many media a traversal reaches. Each medium rotates the value by a hash of the sample, so
+  // that media crossed by the same ray draw independent distances.
+  auto get_medium_1d(std::uint32_t medium) -> float {
+    auto dimension = m_state.dimension;
+    m_state.dimension = s_camera_dimensions + m_state.bounce * s_bounce_dimensions + s_medium_dimension;
+    auto value = get_1d();
+    m_state.dimension = dimension;
+
+    auto rotation = prng::to_unit_float(prng::hash(m_state.x, m_state.y, m_state.sample_index, m_state.bounce, medium));
+    value += rotation;
+    return value >= 1.0f ? value - 1.0f : value;
+  }
+
+  auto get_unit_vector() -> glm::vec3 {
+    auto u = get_2d();
+    auto a = 2.0f * glm::pi<float>() * u.x;
+    auto z = 1.0f - 2.0f * u.y;
+    auto r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    auto cos_sin = math::cos_sin(a);
+    return glm::vec3{r * cos_sin.x, r * cos_sin.y, z};
+  }
+
+protected:
+  SamplerState m_state{};
+};
+
+// Uncorrelated values, each one a hash of the pixel, the sample index, the dimension and the seed
+class IndependentSampler : public Sampler {
+public:
+  explicit IndependentSampler(std::uint32_t seed = 0u)
+    : m_seed{seed}
+  {}
+
+  auto get_1d() -> float override {
+    return prng::to_unit_float(next_bits());
+  }
+
+  auto get_2d() -> glm::vec2 override {
+    auto x = prng::to_unit_float(next_bits());
+    return glm::vec2{x, prng::to_unit_float(next_bits())};
+  }
+
+private:
+  std::uint32_t m_seed{};
+
+  auto next_bits() -> std::uint32_t {
+    auto key = (std::uint64_t{m_state.x} << 32) | m_state.y;
+    auto counter = (std::uint64_t{m_state.sample_index} << 32) | m_state.dimension++;
+    return prng::get_bits(key, counter, m_seed);
+  }
+};
+
+// Owen scrambled Sobol points (Burley 2020, "Practical Hash-based Owen Scrambling").
+// Higher dimensions are padded with independently scrambled and shuffled 2D Sobol points.
+// Inside each tile of 64x64 pixels, pixels take consecutive chunks of a single sequence in
+// Morton order, which spreads the error of neighboring pixels as blue noise (Ahmed and Wonka
+// 2020, "Screen-Space Blue-Noise Diffusion of Monte Carlo Sampling Error via Hierarchical
+// Ordering of Pixels"). Any number of samples per pixel is supported.
+class SobolSampler : public Sampler {
+public:
+  SobolSampler(unsigned samples_per_pixel, std::uint32_t seed)
+    : m_samples_per_pixel{std::max(samples_per_pixel, 1u)}
+    , m_seed{seed}
+  {}
+
+  auto start_pixel_sample(unsigned x, unsigned y, unsigned sample_index) -> void override {
+    Sampler::start_pixel_sample(x, y, sample_index);
+    auto tile_pixel = interleave_bits(x % s_tile_size) | (interleave_bits(y % s_tile_size) << 1);
+    m_index = tile_pixel * m_samples_per_pixel + sample_index;
+    m_tile_seed = prng::hash(x / s_tile_size, y / s_tile_size, m_seed);
+  }
+
+  auto get_1d() -> float override {
+    auto seed = prng::hash(m_tile_seed, m_state.dimension++);
+    auto index = nested_uniform_scramble(m_index, prng::hash(seed));
+    return to_float(nested_uniform_scramble(sobol(index, 0), seed));
+  }
+
+  auto get_2d() -> glm::vec2 override {
+    auto seed = prng::hash(m_tile_seed, m_state.dimension);
+    m_state.dimension += 2;
+    auto index = nested_uniform_scramble(m_index, prng::hash(seed));
+    return glm::vec2{
+      to_float(nested_uniform_scramble(sobol(index, 0), prng::hash(seed, 0u))),
+      to_float(nested_uniform_scramble(sobol(index, 1), prng::hash(seed, 1u)))
+    };
+  }
+
+private:
+  static constexpr auto s_tile_size = 64u;
+
+  unsigned m_samples_per_pixel{};
+  std::uint32_t m_seed{};
+  std::uint32_t m_index{};
+  std::uint32_t m_tile_seed{};
+
+  // The generator matrix of the first dimension reverses the bits of the index,
+  // the one of the second dimension is the Pascal matrix modulo 2 applied after that
+  static auto sobol(std::uint32_t index, unsigned dimension) -> std::uint32_t {
+    auto value = reverse_bits(index);
+    if (dimension == 1) {
+      value ^= (value & 0x55555555u) << 1;
+      value ^= (value & 0x33333333u) << 2;
+      value ^= (value & 0x0f0f0f0fu) << 4;
+      value ^= (value & 0x00ff00ffu) << 8;
+      value ^= (value & 0x0000ffffu) << 16;
+    }
+    return value;
+  }
+
+  static auto reverse_bits(std::uint32_t value) -> std::uint32_t {
+    value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+    value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+    value = ((value >> 4) & 0x0f0f0f0fu) | ((value & 0x0f0f0f0fu) << 4);
+    value = ((value >> 8) & 0x00ff00ffu) | ((value & 0x00ff00ffu) << 8);
+    return (value >> 16) | (value << 16);
+  }
+
+  static auto laine_karras_permutation(std::uint32_t value, std::uint32_t seed) -> std::uint32_t {
+    value += seed;
+    value ^= value * 0x6c50b47cu;
+    value ^= value * 0xb82f1e52u;
+    value ^= value * 0xc7afe638u;
+    value ^= value * 0x8d22f6e6u;
+    return value;
+  }
+
+  static auto nested_uniform_scramble(std::uint32_t value, std::uint32_t seed) -> std::uint32_t {
+    return reverse_bits(laine_karras_permutation(reverse_bits(value), seed));
+  }
+
+  // Spreads the lower 16 bits of value to the even bits
+  static auto interleave_bits(std::uint32_t value) -> std::uint32_t {
+    value &= 0xffffu;
+    value = (value | (value << 8)) & 0x00ff00ffu;
+    value = (value | (value << 4)) & 0x0f0f0f0fu;
+    value = (value | (value << 2)) & 0x33333333u;
+    value = (value | (value << 1)) & 0x55555555u;
+    return value;
+  }
+
+  static auto to_float(std::uint32_t value) -> float {
+    return std::min(static_cast<float>(value) * 0x1p-32f, 0x1.fffffep-1f);
+  }
+};
+
+enum class SamplerType {
+  independent,
+  sobol,
+};
+
+auto make_sampler(SamplerType type, unsigned samples_per_pixel, std::uint32_t seed) -> std::unique_ptr<Sampler> {
+  switch (type) {
+    case SamplerType::independent:
+      return std::make_unique<IndependentSampler>(seed);
+    case SamplerType::sobol:
+      return std::make_unique<SobolSampler>(samples_per_pixel, seed);
+  }
+  return std::make_unique<IndependentSampler>();
+}
+
+// The sampler that materials and media of the calling thread draw from
+namespace sampling {
+  thread_local auto independent = IndependentSampler{};
+  thread_local Sampler* bound = nullptr;
+
+  auto current() -> Sampler& {
+    return bound != nullptr ? *bound : independent;
+  }
+
+  // Pass nullptr to go back to independent samples
+  auto bind(Sampler* sampler) -> void {
+    bound = sampler;
+  }
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef RT_SCENE_HPP
+#define RT_SCENE_HPP
+
+#include "hittable.hpp"
+#include "renderer.hpp"
+#include "animation.hpp"
+#include "framebuffer.hpp"
+#include "memory.hpp"
+
+#include <glm/vec3.hpp>
+
+struct Scene {
+  Hittables hittables{};
+  RenderOptions options{};
+  unsigned width{};
+  unsigned height{};
+  // empty for still images
+  Animation animation{};
+};
+
+// The objects of the scene, the ones of every frame when it is animated, and its framebuffer
+auto account_memory(const Scene& scene) -> memory::Account {
+  auto account = memory::Account{};
+  for (const auto& hittable : scene.hittables) {
+    hittable->account(account);
+  }
+  for (const auto& instance : scene.animation.instances) {
+    instance->account(account);
+  }
+  for (const auto& track : scene.animation.objects) {
+    track.object->account(account);
+  }
+
+  auto pixels = std::uint64_t{scene.width} * scene.height;
+  account.add(memory::Category::framebuffer, sizeof(Framebuffer) + pixels * (sizeof(glm::vec3) + sizeof(unsigned)));
+  return account;
+}
+
+#endif
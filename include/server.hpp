@@ -0,0 +1,366 @@
+#ifndef RT_SERVER_HPP
+#define RT_SERVER_HPP
+
+#include "command-line.hpp"
+#include "renderer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+enum class JobState {
+  queued,
+  running,
+  done,
+  failed,
+  cancelled,
+};
+
+auto to_string(JobState state) -> std::string {
+  switch (state) {
+    case JobState::queued: return "queued";
+    case JobState::running: return "running";
+    case JobState::done: return "done";
+    case JobState::failed: return "failed";
+    case JobState::cancelled: return "cancelled";
+  }
+  return "unknown";
+}
+
+struct Job {
+  unsigned id{};
+  int priority{};
+  CommandLine command_line{};
+  JobState state{JobState::queued};
+  std::atomic<float> progress{};
+  std::atomic<bool> cancelled{};
+};
+
+// Renders the job, returns false if it failed
+using RunJob = std::function<bool(const CommandLine&, const RenderHooks&)>;
+
+// finished, failed and cancelled jobs kept for status requests, the oldest ones are forgotten
+constexpr auto g_max_finished_jobs = 64uz;
+
+// Keeps the jobs and runs them one at a time, the one with the highest priority first and
+// then the oldest one. Each job already uses every core.
+class JobQueue final {
+public:
+  explicit JobQueue(RunJob run_job)
+    : m_run_job{std::move(run_job)}
+  {}
+
+  JobQueue(const JobQueue&) = delete;
+  auto operator=(const JobQueue&) -> JobQueue& = delete;
+
+  ~JobQueue() {
+    stop();
+  }
+
+  auto start() -> void {
+    m_worker = std::thread{[this] { work(); }};
+  }
+
+  // Cancels the running job, drops the queued ones and waits for the worker
+  auto stop() -> void {
+    {
+      auto lock = std::scoped_lock{m_mutex};
+      m_stopping = true;
+      for (auto& [id, job] : m_jobs) {
+        job->cancelled = true;
+      }
+    }
+    m_condition.notify_all();
+    if (m_worker.joinable()) {
+      m_worker.join();
+    }
+  }
+
+  auto submit(int priority, CommandLine command_line) -> unsigned {
+    auto lock = std::scoped_lock{m_mutex};
+    auto job = std::make_shared<Job>();
+    job->id = m_next_id++;
+    job->priority = priority;
+    job->command_line = std::move(command_line);
+    m_jobs.emplace(job->id, job);
+    m_condition.notify_one();
+    return job->id;
+  }
+
+  // A queued job is dropped, a running one stops after the tiles being rendered
+  auto cancel(unsigned id) -> bool {
+    auto lock = std::scoped_lock{m_mutex};
+    auto it = m_jobs.find(id);
+    if (it == m_jobs.end()) {
+      return false;
+    }
+    auto& job = *it->second;
+    job.cancelled = true;
+    if (job.state == JobState::queued) {
+      job.state = JobState::cancelled;
+      forget_finished_jobs();
+    }
+    return true;
+  }
+
+  // One line per job: id, state, progress in percent, priority and output
+  auto status(std::optional<unsigned> id = {}) -> std::string {
+    auto lock = std::scoped_lock{m_mutex};
+    auto out = std::ostringstream{};
+    for (const auto& [job_id, job] : m_jobs) {
+      if (id && *id != job_id) {
+        continue;
+      }
+      out << job_id << ' ' << to_string(job->state) << ' ' << job->progress * 100.0f << ' '
+          << job->priority << ' ' << job->command_line.output << '\n';
+    }
+    return out.str();
+  }
+
+private:
+  RunJob m_run_job{};
+  std::mutex m_mutex{};
+  std::condition_variable m_condition{};
+  std::map<unsigned, std::shared_ptr<Job>> m_jobs{};
+  unsigned m_next_id{1};
+  bool m_stopping{};
+  std::thread m_worker{};
+
+  // Must be called with the mutex locked
+  auto forget_finished_jobs() -> void {
+    auto finished = static_cast<std::size_t>(std::ranges::count_if(m_jobs, [](const auto& entry) {
+      auto state = entry.second->state;
+      return state != JobState::queued && state != JobState::running;
+    }));
+    for (auto it = m_jobs.begin(); finished > g_max_finished_jobs && it != m_jobs.end();) {
+      auto state = it->second->state;
+      if (state == JobState::queued || state == JobState::running) {
+        ++it;
+        continue;
+      }
+      it = m_jobs.erase(it);
+      --finished;
+    }
+  }
+
+  // Must be called with the mutex locked
+  auto next_job() -> std::shared_ptr<Job> {
+    auto next = std::shared_ptr<Job>{};
+    for (const auto& [id, job] : m_jobs) {
+      if (job->state == JobState::queued && (!next || job->priority > next->priority)) {
+        next = job;
+      }
+    }
+    return next;
+  }
+
+  auto work() -> void {
+    while (true) {
+      auto job = std::shared_ptr<Job>{};
+      {
+        auto lock = std::unique_lock{m_mutex};
+        m_condition.wait(lock, [this] { return m_stopping || next_job(); });
+        if (m_stopping) {
+          return;
+        }
+        job = next_job();
+        job->state = JobState::running;
+      }
+
+      auto hooks = RenderHooks{};
+      hooks.on_progress = [&job](float progress) { job->progress = progress; };
+      hooks.cancelled = &job->cancelled;
+      auto succeeded = m_run_job(job->command_line, hooks);
+
+      auto lock = std::scoped_lock{m_mutex};
+      job->state = job->cancelled ? JobState::cancelled : succeeded ? JobState::done : JobState::failed;
+      if (job->state == JobState::done) {
+        job->progress = 1.0f;
+      }
+      forget_finished_jobs();
+    }
+  }
+};
+
+// Parses one request and returns the reply:
+//   submit <priority> <scene> [options]  queues a render, replies with the job id
+//   status [id]                          one line per job: id, state, progress, priority, output
+//   cancel <id>                          stops a job
+//   shutdown                             cancels every job and stops the server
+auto handle_request(JobQueue& queue, const std::string& request, bool& shutdown) -> std::string {
+  auto words = std::vector<std::string>{};
+  auto in = std::istringstream{request};
+  for (auto word = std::string{}; in >> word;) {
+    words.push_back(word);
+  }
+  if (words.empty()) {
+    return "error empty request\n";
+  }
+
+  if (words[0] == "submit" && words.size() >= 2) {
+    auto priority = parse_number<int>(words[1]);
+    if (!priority) {
+      return "error invalid priority " + words[1] + "\n";
+    }
+    // parse_command_line skips the program name
+    auto args = std::vector<char*>{words[0].data()};
+    for (auto i = 2uz; i < words.size(); ++i) {
+      args.push_back(words[i].data());
+    }
+    auto command_line = parse_command_line(args);
+    if (!command_line) {
+      return "error invalid options\n";
+    }
+    return std::to_string(queue.submit(*priority, std::move(*command_line))) + "\n";
+  }
+  if (words[0] == "status") {
+    auto id = std::optional<unsigned>{};
+    if (words.size() >= 2) {
+      id = parse_number<unsigned>(words[1]);
+      if (!id) {
+        return "error invalid job " + words[1] + "\n";
+      }
+    }
+    return queue.status(id);
+  }
+  if (words[0] == "cancel" && words.size() >= 2) {
+    auto id = parse_number<unsigned>(words[1]);
+    if (!id || !queue.cancel(*id)) {
+      return "error unknown job " + words[1] + "\n";
+    }
+    return "ok\n";
+  }
+  if (words[0] == "shutdown") {
+    shutdown = true;
+    return "ok\n";
+  }
+  return "error unknown request " + words[0] + "\n";
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+// time a client has to send its whole request line, so that a stalled one does not hold up the others
+constexpr auto g_request_timeout = std::chrono::seconds{5};
+constexpr auto g_max_request_bytes = 64uz * 1024uz;
+
+auto write_reply(int client, const std::string& reply) -> void {
+  for (auto written = 0uz; written < reply.size();) {
+    auto count = write(client, reply.data() + written, reply.size() - written);
+    if (count <= 0) {
+      break;
+    }
+    written += static_cast<std::size_t>(count);
+  }
+}
+
+// The request line of the client, without its newline. Nothing if the client does not send it
+// before the deadline, sends a line that is too long or fails, in which case it is replied an error
+// when it can still read it.
+auto read_request(int client) -> std::optional<std::string> {
+  auto deadline = std::chrono::steady_clock::now() + g_request_timeout;
+  auto request = std::string{};
+  auto buffer = std::array<char, 1024>{};
+  while (request.find('\n') == std::string::npos) {
+    if (request.size() > g_max_request_bytes) {
+      write_reply(client, "error request too long\n");
+      return {};
+    }
+
+    auto time_left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    auto descriptor = pollfd{client, POLLIN, 0};
+    if (time_left.count() <= 0 || poll(&descriptor, 1, static_cast<int>(time_left.count())) <= 0) {
+      write_reply(client, "error request timed out\n");
+      return {};
+    }
+
+    auto count = read(client, buffer.data(), buffer.size());
+    if (count < 0) {
+      return {};
+    }
+    // a client that closes its side without a newline still gets its reply
+    if (count == 0) {
+      break;
+    }
+    request.append(buffer.data(), static_cast<std::size_t>(count));
+  }
+  return request.substr(0, request.find('\n'));
+}
+
+// Listens on a Unix domain socket. Every connection sends one request line and gets its reply.
+auto serve(const std::string& socket_path, RunJob run_job) -> bool {
+  // a client that disconnects before its reply makes the write fail instead of killing the server
+  std::signal(SIGPIPE, SIG_IGN);
+
+  auto address = sockaddr_un{};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "[ERROR] The socket path " << socket_path << " is too long\n";
+    return false;
+  }
+  std::copy(socket_path.begin(), socket_path.end(), address.sun_path);
+
+  auto server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0) {
+    std::cerr << "[ERROR] Failed to create a socket\n";
+    return false;
+  }
+  unlink(socket_path.c_str());
+  if (bind(server, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || listen(server, 16) < 0) {
+    std::cerr << "[ERROR] Failed to listen on " << socket_path << "\n";
+    close(server);
+    return false;
+  }
+  std::cout << "Listening on " << socket_path << "\n";
+
+  auto queue = JobQueue{std::move(run_job)};
+  queue.start();
+
+  auto shutdown = false;
+  while (!shutdown) {
+    auto client = accept(server, nullptr, nullptr);
+    if (client < 0) {
+      continue;
+    }
+
+    if (auto request = read_request(client)) {
+      write_reply(client, handle_request(queue, *request, shutdown));
+    }
+    close(client);
+  }
+
+  queue.stop();
+  close(server);
+  unlink(socket_path.c_str());
+  return true;
+}
+
+#else
+
+auto serve(const std::string&, RunJob) -> bool {
+  std::cerr << "[ERROR] The server needs Unix domain sockets\n";
+  return false;
+}
+
+#endif
+
+#endif
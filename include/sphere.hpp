@@ -2,7 +2,9 @@
 #define RT_SPHERE_HPP
 
 #include "hittable.hpp"
+#include "material.hpp"
 #include "ray.hpp"
+#include "math.hpp"
 
 #include <glm/geometric.hpp>
 #include <glm/vec3.hpp>
@@ -22,6 +24,9 @@ public:
       throw std::invalid_argument{"Sphere radius must be positive"};
     }
 
+    // the texture covers the whole surface
+    m_texture_scale = 1.0f / std::sqrt(4.0f * glm::pi<float>() * m_radius * m_radius);
+
     auto radius_vec = glm::vec3{m_radius};
     auto aabb1 = Aabb{center1 - radius_vec, center1 + radius_vec};
     auto aabb2 = Aabb{center2 - radius_vec, center2 + radius_vec};
@@ -60,12 +65,12 @@ public:
     auto out_normal = (point - center) / m_radius;
     auto texture_coords = get_texture_coords(out_normal);
 
-    return HitRecord{root, front_face, point, front_face ? out_normal : -out_normal, m_material, texture_coords};
+    return HitRecord{root, front_face, point, front_face ? out_normal : -out_normal, m_material.get(), texture_coords, m_texture_scale};
   }
 
   auto get_texture_coords(const glm::vec3& normal) const -> glm::vec2 {
-    auto theta = std::acos(-normal.y);
-    auto phi = std::atan2(-normal.z, normal.x) + glm::pi<float>();
+    auto theta = math::acos(-normal.y);
+    auto phi = math::atan2(-normal.z, normal.x) + glm::pi<float>();
     auto u = phi / (2.0f * glm::pi<float>());
     auto v = theta / glm::pi<float>();
     return {u, v};
@@ -75,11 +80,24 @@ public:
     return m_bounding_box;
   }
 
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      account.add_primitive(memory::Category::spheres, sizeof(*this), m_material.get());
+      m_material->account(account);
+    }
+  }
+
+  auto add_features(SceneFeatures& features) const -> void override {
+    features.motion_blur = features.motion_blur || m_center.direction() != glm::vec3{0.0f};
+    features.lights = features.lights || m_material->emits_light();
+  }
+
 private:
   Ray m_center{};
   float m_radius{};
   std::shared_ptr<Material> m_material{};
   Aabb m_bounding_box{};
+  float m_texture_scale{};
 };
 
 
@@ -0,0 +1,267 @@
+#ifndef RT_STATS_HPP
+#define RT_STATS_HPP
+
+#include "timer.hpp"
+#include "counters.hpp"
+#include "tracing.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Counters for the render report. Every thread counts into its own counters, which are
+// only added up when the report is written, so counting costs a plain increment.
+namespace stats {
+  // Phases can nest: the import time includes the decoding of the model's textures.
+  // Each phase is also a trace marker.
+  enum class Phase {
+    import,
+    texture_decode,
+    bvh_build,
+    render,
+    denoise,
+    output,
+    count,
+  };
+
+  constexpr auto phase_names = std::array{"import", "texture_decode", "bvh_build", "render", "denoise", "output"};
+
+  enum class RayType {
+    camera,
+    indirect,
+    occlusion,
+    // camera rays of the denoiser features, traced after the render
+    feature,
+    count,
+  };
+
+  constexpr auto ray_type_names = std::array{"camera", "indirect", "occlusion", "feature"};
+
+  // deeper bounces are counted with the last one
+  constexpr auto max_depth = 32u;
+
+  struct ThreadCounters {
+    std::array<std::uint64_t, static_cast<std::size_t>(RayType::count)> rays_by_type{};
+    std::array<std::uint64_t, max_depth> rays_by_depth{};
+    // lookups of mip levels in the texture cache
+    std::uint64_t texture_hits{};
+    std::uint64_t texture_misses{};
+    std::uint64_t texture_evictions{};
+  };
+
+  // Counters stay registered after their thread exits, until the next reset
+  auto registry_mutex = std::mutex{};
+  auto registry = std::vector<std::shared_ptr<ThreadCounters>>{};
+  auto phase_nanoseconds = std::array<std::atomic<std::int64_t>, static_cast<std::size_t>(Phase::count)>{};
+
+  // the counters of the calling thread, registered on first use
+  thread_local ThreadCounters* local_counters = nullptr;
+
+  auto thread_counters() -> ThreadCounters& {
+    if (local_counters == nullptr) [[unlikely]] {
+      auto counters = std::make_shared<ThreadCounters>();
+      auto lock = std::scoped_lock{registry_mutex};
+      registry.push_back(counters);
+      local_counters = counters.get();
+    }
+    return *local_counters;
+  }
+
+  auto count_rays(RayType type, unsigned depth, std::uint64_t count = 1u) -> void {
+    auto& counters = thread_counters();
+    counters.rays_by_type[static_cast<std::size_t>(type)] += count;
+    counters.rays_by_depth[std::min(depth, max_depth - 1)] += count;
+  }
+
+  auto count_texture_lookup(bool hit) -> void {
+    auto& counters = thread_counters();
+    ++(hit ? counters.texture_hits : counters.texture_misses);
+  }
+
+  auto count_texture_eviction() -> void {
+    ++thread_counters().texture_evictions;
+  }
+
+  // Zeroes every counter, not thread safe with counting
+  auto reset() -> void {
+    auto lock = std::scoped_lock{registry_mutex};
+    for (auto& counters : registry) {
+      *counters = ThreadCounters{};
+    }
+    for (auto& nanoseconds : phase_nanoseconds) {
+      nanoseconds = 0;
+    }
+    counters::reset();
+  }
+
+  class ScopedPhase final {
+  public:
+    explicit ScopedPhase(Phase phase)
+      : m_phase{phase}
+      , m_trace{phase_names[static_cast<std::size_t>(phase)]}
+    {}
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    auto operator=(const ScopedPhase&) -> ScopedPhase& = delete;
+
+    ~ScopedPhase() {
+      phase_nanoseconds[static_cast<std::size_t>(m_phase)] += static_cast<std::int64_t>(m_timer.elapsed() * 1e6);
+    }
+
+  private:
+    Phase m_phase{};
+    Timer m_timer{};
+    tracing::ScopedTrace m_trace;
+  };
+
+  auto phase_seconds(Phase phase) -> double {
+    return static_cast<double>(phase_nanoseconds[static_cast<std::size_t>(phase)].load()) * 1e-9;
+  }
+
+  // Largest resident set size of the process so far, 0 where it is not known
+  auto peak_memory_bytes() -> std::uint64_t {
+#if defined(__unix__) || defined(__APPLE__)
+    auto usage = rusage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+      return static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+      return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024u;
+#endif
+    }
+#endif
+    return 0u;
+  }
+
+  struct ReportInfo {
+    std::string scene{};
+    unsigned width{};
+    unsigned height{};
+    // pixels rendered, for all the frames
+    std::uint64_t pixels{};
+  };
+
+  auto write_report(const std::string& path, const ReportInfo& info) -> bool {
+    auto file = std::ofstream{path};
+    if (!file) {
+      std::cerr << "[ERROR] Failed to open " << path << "\n";
+      return false;
+    }
+
+    auto lock = std::scoped_lock{registry_mutex};
+    auto total = ThreadCounters{};
+    // rays traced by the render itself, for the throughput
+    auto thread_rays = std::vector<std::uint64_t>{};
+    for (const auto& counters : registry) {
+      auto rays = std::uint64_t{};
+      for (auto type = 0uz; type < total.rays_by_type.size(); ++type) {
+        total.rays_by_type[type] += counters->rays_by_type[type];
+        rays += type != static_cast<std::size_t>(RayType::feature) ? counters->rays_by_type[type] : 0u;
+      }
+      for (auto depth = 0uz; depth < total.rays_by_depth.size(); ++depth) {
+        total.rays_by_depth[depth] += counters->rays_by_depth[depth];
+      }
+      total.texture_hits += counters->texture_hits;
+      total.texture_misses += counters->texture_misses;
+      total.texture_evictions += counters->texture_evictions;
+      if (rays > 0) {
+        thread_rays.push_back(rays);
+      }
+    }
+
+    auto render_seconds = std::max(phase_seconds(Phase::render), 1e-9);
+    auto render_rays = std::uint64_t{};
+    for (auto rays : thread_rays) {
+      render_rays += rays;
+    }
+
+    file << "{\n";
+    file << "  \"scene\": \"" << info.scene << "\",\n";
+    file << "  \"width\": " << info.width << ",\n";
+    file << "  \"height\": " << info.height << ",\n";
+    auto camera_rays = total.rays_by_type[static_cast<std::size_t>(RayType::camera)];
+    file << "  \"samples_per_pixel\": " << static_cast<double>(camera_rays) / static_cast<double>(std::max(info.pixels, std::uint64_t{1})) << ",\n";
+    file << "  \"threads\": " << thread_rays.size() << ",\n";
+
+    file << "  \"phase_seconds\": {";
+    for (auto phase = 0uz; phase < phase_names.size(); ++phase) {
+      file << (phase > 0 ? ", " : "") << '"' << phase_names[phase] << "\": " << phase_seconds(static_cast<Phase>(phase));
+    }
+    file << "},\n";
+
+    auto total_rays = std::uint64_t{};
+    file << "  \"rays_by_type\": {";
+    for (auto type = 0uz; type < ray_type_names.size(); ++type) {
+      file << (type > 0 ? ", " : "") << '"' << ray_type_names[type] << "\": " << total.rays_by_type[type];
+      total_rays += total.rays_by_type[type];
+    }
+    file << "},\n";
+    file << "  \"rays_total\": " << total_rays << ",\n";
+
+    auto last_depth = total.rays_by_depth.size();
+    while (last_depth > 1 && total.rays_by_depth[last_depth - 1] == 0) {
+      --last_depth;
+    }
+    file << "  \"rays_by_depth\": [";
+    for (auto depth = 0uz; depth < last_depth; ++depth) {
+      file << (depth > 0 ? ", " : "") << total.rays_by_depth[depth];
+    }
+    file << "],\n";
+
+    file << "  \"rays_per_second\": " << static_cast<double>(render_rays) / render_seconds << ",\n";
+    file << "  \"rays_per_second_per_thread\": [";
+    for (auto i = 0uz; i < thread_rays.size(); ++i) {
+      file << (i > 0 ? ", " : "") << static_cast<double>(thread_rays[i]) / render_seconds;
+    }
+    file << "],\n";
+    file << "  \"texture_cache\": {\"hits\": " << total.texture_hits << ", \"misses\": " << total.texture_misses
+         << ", \"evictions\": " << total.texture_evictions << "},\n";
+    file << "  \"peak_memory_bytes\": " << peak_memory_bytes();
+
+    // the events that could not be counted are left out
+    if (counters::enabled) {
+      file << ",\n  \"counters\": {";
+      for (auto section = 0uz; section < counters::section_names.size(); ++section) {
+        file << (section > 0 ? ", " : "") << '"' << counters::section_names[section] << "\": {";
+        auto first = true;
+        for (auto event = 0uz; event < counters::event_names.size(); ++event) {
+          if (counters::is_available(static_cast<counters::Event>(event))) {
+            file << (first ? "" : ", ") << '"' << counters::event_names[event] << "\": "
+                 << counters::total(static_cast<counters::Section>(section), static_cast<counters::Event>(event));
+            first = false;
+          }
+        }
+        file << "}";
+      }
+      file << "},\n";
+
+      file << "  \"counters_per_ray\": {";
+      auto first = true;
+      for (auto event = 0uz; event < counters::event_names.size(); ++event) {
+        if (counters::is_available(static_cast<counters::Event>(event))) {
+          auto value = counters::total(counters::Section::render, static_cast<counters::Event>(event));
+          file << (first ? "" : ", ") << '"' << counters::event_names[event] << "\": "
+               << static_cast<double>(value) / static_cast<double>(std::max(render_rays, std::uint64_t{1}));
+          first = false;
+        }
+      }
+      file << "}";
+    }
+    file << "\n}\n";
+
+    return static_cast<bool>(file);
+  }
+}
+
+#endif
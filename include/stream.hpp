@@ -0,0 +1,147 @@
+#ifndef RT_STREAM_HPP
+#define RT_STREAM_HPP
+
+#include "hittable.hpp"
+#include "aabb.hpp"
+#include "ray.hpp"
+
+#include <glm/vec3.hpp>
+
+#include <vector>
+#include <numeric>
+#include <optional>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <span>
+
+// Returns the bounds of the bundle, or nothing if its rays do not share a direction octant
+auto get_ray_interval(std::span<const Ray> rays) -> std::optional<RayInterval> {
+  if (rays.empty()) {
+    return {};
+  }
+
+  auto interval = RayInterval{
+    glm::vec3{std::numeric_limits<float>::max()},
+    glm::vec3{-std::numeric_limits<float>::max()},
+    glm::vec3{std::numeric_limits<float>::max()},
+    glm::vec3{-std::numeric_limits<float>::max()}
+  };
+
+  for (const auto& ray : rays) {
+    for (auto axis = 0; axis < 3; ++axis) {
+      auto d = ray.direction()[axis];
+      if (std::fabs(d) < 1e-8f || std::signbit(d) != std::signbit(rays.front().direction()[axis])) {
+        return {};
+      }
+      auto inv_d = 1.0f / d;
+      interval.origin_min[axis] = std::fmin(interval.origin_min[axis], ray.origin()[axis]);
+      interval.origin_max[axis] = std::fmax(interval.origin_max[axis], ray.origin()[axis]);
+      interval.inv_direction_min[axis] = std::fmin(interval.inv_direction_min[axis], inv_d);
+      interval.inv_direction_max[axis] = std::fmax(interval.inv_direction_max[axis], inv_d);
+    }
+  }
+
+  return interval;
+}
+
+// Spreads the lower 10 bits of value so that there are two zero bits between each of them
+auto expand_bits(std::uint32_t value) -> std::uint32_t {
+  value &= 0x3ffu;
+  value = (value | (value << 16)) & 0x030000ffu;
+  value = (value | (value << 8)) & 0x0300f00fu;
+  value = (value | (value << 4)) & 0x030c30c3u;
+  value = (value | (value << 2)) & 0x09249249u;
+  return value;
+}
+
+// 30 bit Morton code of the point, quantized to a 1024^3 grid over the bounds
+auto morton_code(const glm::vec3& point, const Aabb& bounds) -> std::uint32_t {
+  auto code = 0u;
+  for (auto axis = 0; axis < 3; ++axis) {
+    auto interval = bounds.axes()[static_cast<unsigned>(axis)];
+    auto t = (point[axis] - interval.min) / (interval.max - interval.min);
+    auto cell = static_cast<std::uint32_t>(std::clamp(t, 0.0f, 1.0f) * 1023.0f);
+    code |= expand_bits(cell) << (2 - axis);
+  }
+  return code;
+}
+
+auto get_octant(const glm::vec3& direction) -> std::uint32_t {
+  return (std::signbit(direction.x) ? 1u : 0u)
+       | (std::signbit(direction.y) ? 2u : 0u)
+       | (std::signbit(direction.z) ? 4u : 0u);
+}
+
+// Rays with the same direction octant are grouped together, then sorted by origin along a Morton curve
+auto get_sort_key(const Ray& ray, const Aabb& bounds) -> std::uint32_t {
+  return (get_octant(ray.direction()) << 29) | (morton_code(ray.origin(), bounds) >> 1);
+}
+
+auto get_bounds(const Hittables& hittables) -> Aabb {
+  auto bounds = hittables.front()->bounding_box();
+  for (const auto& hittable : hittables) {
+    bounds = Aabb{bounds, hittable->bounding_box()};
+  }
+  return bounds;
+}
+
+// Traces the rays of the stream whose indices are in indices one at a time
+auto trace_each(RayStream& stream, const Hittables& hittables, std::span<const unsigned> indices) -> void {
+  auto& sampler = sampling::current();
+  auto media = !stream.sampler_states.empty();
+  for (auto i : indices) {
+    if (media) {
+      sampler.set_state(stream.sampler_states[i]);
+    }
+    for (const auto& hittable : hittables) {
+      auto hit_record = hittable->hit(stream.rays[i], 0.0f, stream.max_distances[i]);
+      if (hit_record) {
+        stream.max_distances[i] = hit_record->distance;
+        stream.hits[i] = std::move(hit_record);
+      }
+    }
+  }
+}
+
+// Finds the closest hit of every ray in the stream. Each run of consecutive rays sharing a
+// direction octant, as get_sort_key groups them, is traversed together as a bundle bounded by
+// its interval. Runs that cannot be bounded, with a direction component near zero, would split
+// apart at the first nodes, so their rays are traced one at a time.
+auto trace_stream(RayStream& stream, const Hittables& hittables) -> void {
+  stream.max_distances.assign(stream.rays.size(), std::numeric_limits<float>::max());
+  stream.hits.assign(stream.rays.size(), std::nullopt);
+
+  stream.inv_directions.resize(stream.rays.size());
+  for (auto i = 0u; i < stream.rays.size(); ++i) {
+    stream.inv_directions[i] = 1.0f / stream.rays[i].direction();
+  }
+
+  auto active = std::vector<unsigned>(stream.rays.size());
+  std::iota(active.begin(), active.end(), 0u);
+
+  auto rays = std::span<const Ray>{stream.rays};
+  for (auto begin = 0uz; begin < rays.size();) {
+    auto octant = get_octant(rays[begin].direction());
+    auto end = begin + 1;
+    while (end < rays.size() && get_octant(rays[end].direction()) == octant) {
+      ++end;
+    }
+
+    auto run = std::span{active}.subspan(begin, end - begin);
+    stream.interval = get_ray_interval(rays.subspan(begin, end - begin));
+    if (stream.interval) {
+      for (const auto& hittable : hittables) {
+        hittable->hit_stream(stream, run);
+      }
+    }
+    else {
+      trace_each(stream, hittables, run);
+    }
+    begin = end;
+  }
+  stream.interval.reset();
+}
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef RT_TEXTURE_CACHE_HPP
+#define RT_TEXTURE_CACHE_HPP
+
+#include "image.hpp"
+#include "stats.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// The mip levels of the textures loaded on first access, kept within a memory budget. The cache
+// is split in shards, each with its own lock and least recently used list, so that threads
+// looking up different levels rarely wait for each other. The budget is shared by the shards:
+// the bytes of every level are added up, and levels are evicted from the shards in turn while
+// the total exceeds it. Every thread also keeps the last levels it looked up, which it finds
+// again without taking any lock.
+namespace texture_cache {
+  struct Key {
+    // unique to each texture, addresses could be reused by the textures of another scene
+    std::uint64_t texture{};
+    unsigned level{};
+
+    auto operator==(const Key&) const -> bool = default;
+  };
+
+  struct KeyHash {
+    auto operator()(const Key& key) const -> std::size_t {
+      return std::hash<std::uint64_t>{}(key.texture * 64u + key.level);
+    }
+  };
+
+  using Level = std::shared_ptr<const Image>;
+
+  // bytes and number of the levels in the shards
+  auto resident_bytes = std::atomic<std::size_t>{};
+  auto resident_levels = std::atomic<std::size_t>{};
+
+  class Shard final {
+  public:
+    auto find(const Key& key) -> Level {
+      auto lock = std::scoped_lock{m_mutex};
+      auto it = m_entries.find(key);
+      if (it == m_entries.end()) {
+        return {};
+      }
+      m_lru.splice(m_lru.begin(), m_lru, it->second.position);
+      return it->second.level;
+    }
+
+    // Levels that were not asked for are inserted as the least recently used, to be evicted first.
+    // False if the level was already there.
+    auto insert(const Key& key, Level level, bool requested) -> bool {
+      auto lock = std::scoped_lock{m_mutex};
+      if (m_entries.contains(key)) {
+        return false;
+      }
+      resident_bytes += level->size();
+      ++resident_levels;
+      auto position = requested ? m_lru.insert(m_lru.begin(), key) : m_lru.insert(m_lru.end(), key);
+      m_entries.emplace(key, Entry{std::move(level), position});
+      return true;
+    }
+
+    // Evicts the least recently used level, unless it is the one to keep. False if nothing was evicted.
+    auto evict(const Key& keep) -> bool {
+      auto lock = std::scoped_lock{m_mutex};
+      if (m_lru.empty() || m_lru.back() == keep) {
+        return false;
+      }
+      remove(m_entries.find(m_lru.back()));
+      stats::count_texture_eviction();
+      return true;
+    }
+
+    auto erase(const Key& key) -> void {
+      auto lock = std::scoped_lock{m_mutex};
+      auto it = m_entries.find(key);
+      if (it != m_entries.end()) {
+        remove(it);
+      }
+    }
+
+  private:
+    struct Entry {
+      Level level{};
+      std::list<Key>::iterator position{};
+    };
+
+    std::mutex m_mutex{};
+    // the most recently used first
+    std::list<Key> m_lru{};
+    std::unordered_map<Key, Entry, KeyHash> m_entries{};
+
+    auto remove(std::unordered_map<Key, Entry, KeyHash>::iterator it) -> void {
+      resident_bytes -= it->second.level->size();
+      --resident_levels;
+      m_lru.erase(it->second.position);
+      m_entries.erase(it);
+    }
+  };
+
+  constexpr auto num_shards = 16uz;
+  auto shards = std::array<Shard, num_shards>{};
+
+  // shared by the shards, 0 for no limit
+  auto budget_bytes = std::atomic<std::size_t>{};
+  // the shard to evict from next, so that every shard gives up its least recently used levels
+  auto next_eviction = std::atomic<std::size_t>{};
+
+  auto next_texture_id = std::atomic<std::uint64_t>{1u};
+
+  // Levels evicted from the cache stay alive while a thread still remembers them, so the memory
+  // used can exceed the budget by up to num_recent levels per thread
+  struct RecentLevel {
+    Key key{};
+    Level level{};
+  };
+
+  constexpr auto num_recent = 8uz;
+  thread_local auto recent = std::array<RecentLevel, num_recent>{};
+  thread_local auto next_recent = 0uz;
+
+  auto set_budget(std::size_t bytes) -> void {
+    budget_bytes = bytes;
+  }
+
+  auto new_texture_id() -> std::uint64_t {
+    return next_texture_id.fetch_add(1u, std::memory_order_relaxed);
+  }
+
+  auto get_shard(const Key& key) -> Shard& {
+    return shards[KeyHash{}(key) % num_shards];
+  }
+
+  // Keeps the level alive for the calling thread, for its next num_recent - 1 lookups at least
+  auto remember(const Key& key, Level level) -> const Image* {
+    auto& slot = recent[next_recent];
+    next_recent = (next_recent + 1) % num_recent;
+    slot = RecentLevel{key, std::move(level)};
+    return slot.level.get();
+  }
+
+  // The level if it is loaded. The image stays valid for the next num_recent - 1 lookups of the
+  // calling thread.
+  auto find(const Key& key) -> const Image* {
+    for (const auto& entry : recent) {
+      if (entry.level && entry.key == key) {
+        stats::count_texture_lookup(true);
+        return entry.level.get();
+      }
+    }
+
+    auto level = get_shard(key).find(key);
+    if (!level) {
+      return nullptr;
+    }
+    stats::count_texture_lookup(true);
+    return remember(key, std::move(level));
+  }
+
+  // A level that was asked for is never evicted by its own insert, so the cache holds it even when
+  // it exceeds the budget on its own. Levels that were not asked for, like the ones a miss builds
+  // on the way, are only kept while they fit.
+  auto insert(const Key& key, Level level, bool requested) -> void {
+    if (!get_shard(key).insert(key, std::move(level), requested)) {
+      return;
+    }
+
+    // texture ids start at 1, so no level has the key of a level not asked for
+    auto keep = requested ? key : Key{};
+    auto budget = budget_bytes.load(std::memory_order_relaxed);
+    // stops after a turn of the shards that evicted nothing
+    for (auto failures = 0uz; budget > 0 && resident_bytes > budget && failures < num_shards;) {
+      auto& shard = shards[next_eviction++ % num_shards];
+      failures = shard.evict(keep) ? 0uz : failures + 1;
+    }
+  }
+
+  // Peeks at a level without counting a lookup or remembering it, for building other levels from it
+  auto peek(const Key& key) -> Level {
+    return get_shard(key).find(key);
+  }
+
+  auto erase(const Key& key) -> void {
+    get_shard(key).erase(key);
+  }
+}
+
+#endif
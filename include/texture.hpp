@@ -3,86 +3,328 @@
 
 #include "image.hpp"
 #include "perlin.hpp"
+#include "memory.hpp"
+#include "math.hpp"
+#include "texture-cache.hpp"
+#include "stats.hpp"
 
 #include <glm/vec3.hpp>
 
 #include <memory>
 #include <cmath>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <numbers>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The cell of the point in a checker of cells of size 1 / inv_scale: 0 on even cells and 1 on
+// odd cells, negative coordinates included
+auto checker_parity(float inv_scale, const glm::vec3& point) -> std::size_t {
+  auto x = static_cast<int>(std::floor(inv_scale * point.x));
+  auto y = static_cast<int>(std::floor(inv_scale * point.y));
+  auto z = static_cast<int>(std::floor(inv_scale * point.z));
+  return static_cast<std::size_t>((x + y + z) & 1);
+}
+
+struct CheckerColors {
+  float inv_scale{};
+  std::array<glm::vec3, 2> colors{};
+};
 
 class Texture {
 public:
   virtual ~Texture() = default;
 
-  virtual auto value(float u, float v, const glm::vec3& point) const -> glm::vec3 = 0;
+  // footprint is the width of the area seen around (u, v), in texture coordinates
+  virtual auto value(float u, float v, const glm::vec3& point, float footprint) const -> glm::vec3 = 0;
+  virtual auto account(memory::Account& account) const -> void = 0;
+
+  // The value if it is the same everywhere, so it can be folded when the scene is built
+  virtual auto constant() const -> std::optional<glm::vec3> {
+    return {};
+  }
+
+  // The scale and the colors if it is a checker of two constant colors, so materials can
+  // evaluate it in place
+  virtual auto checker_colors() const -> std::optional<CheckerColors> {
+    return {};
+  }
 };
 
 class SolidColor : public Texture {
 public:
   explicit SolidColor(const glm::vec3& color) : m_color{color} {}
 
-  auto value(float, float, const glm::vec3&) const -> glm::vec3 override {
+  auto value(float, float, const glm::vec3&, float) const -> glm::vec3 override {
     return m_color;
   }
 
+  auto constant() const -> std::optional<glm::vec3> override {
+    return m_color;
+  }
+
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      account.add(memory::Category::textures, sizeof(*this));
+    }
+  }
+
 private:
   glm::vec3 m_color{};
 };
 
+// A checker of two constant textures keeps their colors in place and picks one by the parity
+// of the cell, other textures are evaluated through their value
 class CheckerTexture : public Texture {
 public:
   CheckerTexture(float scale, std::shared_ptr<Texture> even, std::shared_ptr<Texture> odd) 
     : m_inv_scale{1.0f / scale}
-    , m_even{std::move(even)}
-    , m_odd{std::move(odd)} {}
+    , m_colors{constant_colors(*even, *odd)}
+    , m_textures{m_colors ? Textures{} : Textures{std::move(even), std::move(odd)}} {}
 
   CheckerTexture(float scale, const glm::vec3& even, const glm::vec3& odd) 
-    : CheckerTexture(scale, std::make_shared<SolidColor>(even), std::make_shared<SolidColor>(odd)) {}
+    : m_inv_scale{1.0f / scale}
+    , m_colors{Colors{even, odd}}
+    , m_textures{} {}
 
-  auto value(float u, float v, const glm::vec3& point) const -> glm::vec3 override {
-    auto x = static_cast<int>(std::floor(m_inv_scale * point.x));
-    auto y = static_cast<int>(std::floor(m_inv_scale * point.y));
-    auto z = static_cast<int>(std::floor(m_inv_scale * point.z));
+  auto value(float u, float v, const glm::vec3& point, float footprint) const -> glm::vec3 override {
+    auto parity = checker_parity(m_inv_scale, point);
+    if (m_colors) {
+      return (*m_colors)[parity];
+    }
+    return m_textures[parity]->value(u, v, point, footprint);
+  }
+
+  auto constant() const -> std::optional<glm::vec3> override {
+    if (m_colors && (*m_colors)[0] == (*m_colors)[1]) {
+      return (*m_colors)[0];
+    }
+    return {};
+  }
 
-    auto is_even = (x + y + z) % 2 == 0;
+  auto checker_colors() const -> std::optional<CheckerColors> override {
+    if (m_colors) {
+      return CheckerColors{m_inv_scale, *m_colors};
+    }
+    return {};
+  }
 
-    return is_even ? m_even->value(u, v, point) : m_odd->value(u, v, point);
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      account.add(memory::Category::textures, sizeof(*this));
+      for (const auto& texture : m_textures) {
+        if (texture) {
+          texture->account(account);
+        }
+      }
+    }
   }
 
 private:
+  using Colors = std::array<glm::vec3, 2>;
+  using Textures = std::array<std::shared_ptr<Texture>, 2>;
+
+  static auto constant_colors(const Texture& even, const Texture& odd) -> std::optional<Colors> {
+    auto even_color = even.constant();
+    auto odd_color = odd.constant();
+    if (even_color && odd_color) {
+      return Colors{*even_color, *odd_color};
+    }
+    return {};
+  }
+
   float m_inv_scale{};
-  std::shared_ptr<Texture> m_even{};
-  std::shared_ptr<Texture> m_odd{};
+  // the colors of the even and odd cells when both are constant
+  std::optional<Colors> m_colors{};
+  Textures m_textures{};
 };
 
+// Bilinear filtering of the image, texel centers are at half coordinates
+auto bilinear(const Image& image, float u, float v) -> glm::vec3 {
+  auto x = u * static_cast<float>(image.width()) - 0.5f;
+  auto y = v * static_cast<float>(image.height()) - 0.5f;
+  auto x0 = std::floor(x);
+  auto y0 = std::floor(y);
+  auto tx = x - x0;
+  auto ty = y - y0;
+
+  auto max_i = static_cast<int>(image.width()) - 1;
+  auto max_j = static_cast<int>(image.height()) - 1;
+  auto i0 = std::clamp(static_cast<int>(x0), 0, max_i);
+  auto i1 = std::clamp(static_cast<int>(x0) + 1, 0, max_i);
+  auto j0 = std::clamp(static_cast<int>(y0), 0, max_j);
+  auto j1 = std::clamp(static_cast<int>(y0) + 1, 0, max_j);
+
+  auto row0 = (1.0f - tx) * image.at(static_cast<unsigned>(i0), static_cast<unsigned>(j0)) + tx * image.at(static_cast<unsigned>(i1), static_cast<unsigned>(j0));
+  auto row1 = (1.0f - tx) * image.at(static_cast<unsigned>(i0), static_cast<unsigned>(j1)) + tx * image.at(static_cast<unsigned>(i1), static_cast<unsigned>(j1));
+  return (1.0f - ty) * row0 + ty * row1;
+}
+
+// Blends the two mip levels whose texels are closest to the footprint, with bilinear filtering
+// in each. get_level(index) returns the image of a level.
+template <typename GetLevel>
+auto filter_mip_levels(float u, float v, float footprint, unsigned width, unsigned height, std::size_t num_levels, GetLevel&& get_level) -> glm::vec3 {
+  auto texels = footprint * static_cast<float>(std::max(width, height));
+  if (texels <= 1.0f || num_levels == 1) {
+    return bilinear(get_level(0uz), u, v);
+  }
+
+  auto level = std::min(math::log(texels) / std::numbers::ln2_v<float>, static_cast<float>(num_levels - 1));
+  auto lower = static_cast<std::size_t>(level);
+  auto color = bilinear(get_level(lower), u, v);
+  if (lower + 1 == num_levels) {
+    return color;
+  }
+  auto t = level - static_cast<float>(lower);
+  return (1.0f - t) * color + t * bilinear(get_level(lower + 1), u, v);
+}
+
+// An image with its mip levels, each half the size of the previous one
 class ImageTexture : public Texture {
 public:
-  ImageTexture(const Image& image) : m_image{image} {}
+  ImageTexture(const Image& image) : m_levels{get_mip_levels(image)} {}
 
-  auto value(float u, float v, const glm::vec3&) const -> glm::vec3 override {
-    auto widthf = static_cast<float>(m_image.width);
-    auto heightf = static_cast<float>(m_image.height);
-    auto i = static_cast<unsigned>(u * widthf);
-    auto j = static_cast<unsigned>(v * heightf);
+  auto value(float u, float v, const glm::vec3&, float footprint) const -> glm::vec3 override {
+    const auto& base = m_levels.front();
+    return filter_mip_levels(u, v, footprint, base.width(), base.height(), m_levels.size(), [this](std::size_t level) -> const Image& {
+      return m_levels[level];
+    });
+  }
 
-    i = std::clamp(i, 0u, m_image.width - 1u);
-    j = std::clamp(j, 0u, m_image.height - 1u);
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      auto size = sizeof(*this) + m_levels.size() * sizeof(Image);
+      for (const auto& level : m_levels) {
+        size += level.size();
+      }
+      account.add(memory::Category::textures, size);
+    }
+  }
+
+private:
+  std::vector<Image> m_levels{};
+};
 
-    return m_image.pixels[i + m_image.width * j];
+// An image file decoded when it is first looked up, whose mip levels are kept in the texture
+// cache and may be evicted and decoded again
+class LazyImageTexture : public Texture {
+public:
+  // width and height are those of the image in the file
+  LazyImageTexture(std::string path, unsigned width, unsigned height)
+    : m_path{std::move(path)}
+    , m_width{width}
+    , m_height{height}
+    , m_num_levels{get_num_mip_levels(width, height)}
+    , m_id{texture_cache::new_texture_id()}
+  {}
+
+  LazyImageTexture(const LazyImageTexture&) = delete;
+  auto operator=(const LazyImageTexture&) -> LazyImageTexture& = delete;
+
+  ~LazyImageTexture() override {
+    for (auto level = 0u; level < m_num_levels; ++level) {
+      texture_cache::erase(texture_cache::Key{m_id, level});
+    }
+  }
+
+  auto value(float u, float v, const glm::vec3&, float footprint) const -> glm::vec3 override {
+    return filter_mip_levels(u, v, footprint, m_width, m_height, m_num_levels, [this](std::size_t level) -> const Image& {
+      return get_level(static_cast<unsigned>(level));
+    });
+  }
+
+  // the levels are in the cache, which is accounted for apart from the scene
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      account.add(memory::Category::textures, sizeof(*this) + m_path.capacity());
+    }
   }
 
 private:
-  Image m_image{};
+  std::string m_path{};
+  unsigned m_width{};
+  unsigned m_height{};
+  unsigned m_num_levels{};
+  std::uint64_t m_id{};
+  // held while decoding, so that a file is decoded once when several threads miss it
+  mutable std::mutex m_load_mutex{};
+  mutable std::atomic<bool> m_failed{};
+
+  auto get_level(unsigned level) const -> const Image& {
+    static const auto black = Image{1u, 1u, Image::Format::rgb8};
+
+    auto key = texture_cache::Key{m_id, level};
+    if (auto image = texture_cache::find(key)) {
+      return *image;
+    }
+
+    auto lock = std::scoped_lock{m_load_mutex};
+    if (auto image = texture_cache::find(key)) {
+      return *image;
+    }
+    if (m_failed) {
+      return black;
+    }
+
+    stats::count_texture_lookup(false);
+    auto image = get_finer_level(level);
+    if (!image) {
+      std::cerr << "[ERROR] Failed to load the texture " << m_path << '\n';
+      m_failed = true;
+      return black;
+    }
+
+    // the levels built on the way to the one asked for are cached too, as the first to be
+    // evicted, so that a later miss on them does not decode the file again
+    auto phase = stats::ScopedPhase{stats::Phase::texture_decode};
+    auto [current, current_level] = std::move(*image);
+    for (; current_level < level; ++current_level) {
+      texture_cache::insert(texture_cache::Key{m_id, current_level}, current, false);
+      current = std::make_shared<const Image>(downsample(*current));
+    }
+    texture_cache::insert(key, current, true);
+    return *texture_cache::remember(key, std::move(current));
+  }
+
+  // The closest level to build the given one from: a finer level still in the cache, or else the
+  // image decoded from the file
+  auto get_finer_level(unsigned level) const -> std::optional<std::pair<texture_cache::Level, unsigned>> {
+    for (auto finer = level; finer > 0u; --finer) {
+      if (auto cached = texture_cache::peek(texture_cache::Key{m_id, finer - 1u})) {
+        return std::pair{std::move(cached), finer - 1u};
+      }
+    }
+
+    auto image = load_image(m_path);
+    if (!image || image->width() != m_width || image->height() != m_height) {
+      return {};
+    }
+    return std::pair{std::make_shared<const Image>(std::move(*image)), 0u};
+  }
 };
 
 class NoiseTexture : public Texture {
 public:
   NoiseTexture(float scale = 1.0f) : m_perlin{}, m_scale{scale} {}
 
-  auto value(float, float, const glm::vec3& point) const -> glm::vec3 override {
+  auto value(float, float, const glm::vec3& point, float) const -> glm::vec3 override {
     return glm::vec3{0.5f} * (1.0f + std::sin(m_scale * point.z + 10.0f * m_perlin.turb(m_scale * point)));
   }
 
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      account.add(memory::Category::textures, sizeof(*this));
+    }
+  }
+
 private:
   Perlin m_perlin{};
   float m_scale{};
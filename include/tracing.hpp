@@ -0,0 +1,129 @@
+#ifndef RT_TRACING_HPP
+#define RT_TRACING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped markers written as a Chrome trace (chrome://tracing or ui.perfetto.dev). Every
+// thread records into its own buffer, so recording takes no lock. While tracing is off, a
+// marker only checks a flag.
+namespace tracing {
+  using Clock = std::chrono::steady_clock;
+
+  struct Event {
+    // names are string literals, they are not copied
+    const char* name{};
+    std::int64_t begin{};
+    std::int64_t end{};
+    // shown as the value argument of the event when not negative, like the index of a tile
+    std::int64_t value{-1};
+  };
+
+  struct ThreadBuffer {
+    unsigned thread_id{};
+    std::vector<Event> events{};
+  };
+
+  auto enabled = std::atomic<bool>{};
+  auto epoch = Clock::time_point{};
+  auto registry_mutex = std::mutex{};
+  auto registry = std::vector<std::shared_ptr<ThreadBuffer>>{};
+
+  thread_local ThreadBuffer* local_buffer = nullptr;
+
+  auto thread_buffer() -> ThreadBuffer& {
+    if (local_buffer == nullptr) [[unlikely]] {
+      auto buffer = std::make_shared<ThreadBuffer>();
+      auto lock = std::scoped_lock{registry_mutex};
+      buffer->thread_id = static_cast<unsigned>(registry.size());
+      registry.push_back(buffer);
+      local_buffer = buffer.get();
+    }
+    return *local_buffer;
+  }
+
+  auto now() -> std::int64_t {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+  }
+
+  // Drops the events recorded so far and starts recording
+  auto start() -> void {
+    auto lock = std::scoped_lock{registry_mutex};
+    for (auto& buffer : registry) {
+      buffer->events.clear();
+    }
+    epoch = Clock::now();
+    enabled = true;
+  }
+
+  class ScopedTrace final {
+  public:
+    explicit ScopedTrace(const char* name, std::int64_t value = -1)
+      : m_name{name}
+      , m_value{value}
+    {
+      if (enabled.load(std::memory_order_relaxed)) [[unlikely]] {
+        m_begin = now();
+      }
+    }
+
+    ScopedTrace(const ScopedTrace&) = delete;
+    auto operator=(const ScopedTrace&) -> ScopedTrace& = delete;
+
+    ~ScopedTrace() {
+      if (m_begin >= 0) [[unlikely]] {
+        thread_buffer().events.push_back(Event{m_name, m_begin, now(), m_value});
+      }
+    }
+
+  private:
+    const char* m_name{};
+    std::int64_t m_value{};
+    // negative when tracing was off as the scope began
+    std::int64_t m_begin{-1};
+  };
+
+  // Stops recording and writes the events, which must not be recorded meanwhile
+  auto write(const std::string& path) -> bool {
+    enabled = false;
+    auto file = std::ofstream{path};
+    if (!file) {
+      std::cerr << "[ERROR] Failed to open " << path << "\n";
+      return false;
+    }
+
+    auto lock = std::scoped_lock{registry_mutex};
+    file << "{\"traceEvents\": [\n";
+    auto first = true;
+    for (const auto& buffer : registry) {
+      if (buffer->events.empty()) {
+        continue;
+      }
+      file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->thread_id
+           << ", \"args\": {\"name\": \"thread " << buffer->thread_id << "\"}}";
+      first = false;
+      // microseconds, with the nanoseconds as decimals
+      for (const auto& event : buffer->events) {
+        file << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->thread_id
+             << ", \"ts\": " << event.begin / 1000 << '.' << event.begin % 1000 / 100
+             << ", \"dur\": " << (event.end - event.begin) / 1000 << '.' << (event.end - event.begin) % 1000 / 100;
+        if (event.value >= 0) {
+          file << ", \"args\": {\"value\": " << event.value << "}";
+        }
+        file << "}";
+      }
+    }
+    file << "\n]}\n";
+
+    return static_cast<bool>(file);
+  }
+}
+
+#endif
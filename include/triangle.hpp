@@ -9,6 +9,8 @@
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
 #include <glm/geometric.hpp>
+#include <glm/mat2x2.hpp>
+#include <glm/matrix.hpp>
 
 #include <memory>
 
@@ -24,6 +26,11 @@ public:
     , m_abxac(glm::cross(b - a, c - a))
     , m_material(material) 
   {
+    // the square root of the ratio between the areas covered in texture space and in the scene
+    auto texture_area = std::fabs(glm::determinant(glm::mat2{tb - ta, tc - ta}));
+    auto area = glm::length(m_abxac);
+    m_texture_scale = area > 0.0f ? std::sqrt(texture_area / area) : 0.0f;
+
     auto min = glm::vec3{
       std::fmin(std::fmin(a.x, b.x), c.x),
       std::fmin(std::fmin(a.y, b.y), c.y),
@@ -43,6 +50,17 @@ public:
     return m_bounding_box;
   }
 
+  auto account(memory::Account& account) const -> void override {
+    if (account.visit(this)) {
+      account.add_primitive(memory::Category::triangles, sizeof(*this), m_material.get());
+      m_material->account(account);
+    }
+  }
+
+  auto add_features(SceneFeatures& features) const -> void override {
+    features.lights = features.lights || m_material->emits_light();
+  }
+
   auto hit(const Ray& ray, float min_distance, float max_distance) const -> std::optional<HitRecord> override {
     // o + dt = p + u(b - a) + v(c - a)
     // PO = matrix(b - a, c - a, -d) * vector(u, v, t)
@@ -84,7 +102,7 @@ public:
 
     auto tex = w * m_ta + u * m_tb + v * m_tc;
 
-    return HitRecord{t, front_face, ray.at(t), front_face ? normal : -normal, m_material, tex};
+    return HitRecord{t, front_face, ray.at(t), front_face ? normal : -normal, m_material.get(), tex, m_texture_scale};
   }
 
   auto a() const -> glm::vec3 {
@@ -140,6 +158,7 @@ private:
   glm::vec3 m_abxac{};
   std::shared_ptr<Material> m_material{};
   Aabb m_bounding_box{};
+  float m_texture_scale{};
 };
 
 #endif
\ No newline at end of file
@@ -1,510 +1,226 @@
-#include "sphere.hpp"
-#include "quad.hpp"
+#include "scenes.hpp"
 #include "renderer.hpp"
-#include "material.hpp"
-#include "constant-medium.hpp"
-#include "bvh.hpp"
-#include "texture.hpp"
-#include "image.hpp"
-#include "model.hpp"
-
-#include <glm/ext/scalar_constants.hpp>
-#include <glm/geometric.hpp>
+#include "command-line.hpp"
+#include "denoiser.hpp"
+#include "server.hpp"
+#include "stats.hpp"
+#include "tracing.hpp"
+#include "counters.hpp"
+#include "memory.hpp"
+#include "texture-cache.hpp"
 
 #include <memory>
-
-auto random_color(float min = 0.0f, float max = 1.0f) -> glm::vec3 {
-  return glm::vec3{prng::get_real(min, max), prng::get_real(min, max), prng::get_real(min, max)};
-}
-
-auto bouncing_spheres() {
-  auto ppm = Ppm{"output.ppm", 800, 500};
-  constexpr auto fov = 20.0f * glm::pi<float>() / 180.0f;
-  constexpr auto num_samples = 30u;
-  constexpr auto max_depth = 10u;
-  constexpr auto look_from = glm::vec3{13.0f, 2.0f, 3.0f};
-  constexpr auto look_at = glm::vec3{0.0f, 0.0f, 0.0f};
-  constexpr auto defocus_angle = 0.6f * glm::pi<float>() / 180.0f;
-  auto focus_distance = 10.0f;
-
-  auto hittables = Hittables{};
-
-  auto checker = std::make_shared<CheckerTexture>(0.6, glm::vec3{0.2f, 0.4f, 0.1f}, glm::vec3{0.1f, 0.2f, 0.5f});
-  auto ground_material = std::make_shared<Lambertian>(checker);
-  auto ground = std::make_shared<Sphere>(glm::vec3{0.0f, -1000.0f, 0.0f}, 1000.0f, ground_material);
-  hittables.push_back(ground);
-
-  for (auto a = -11; a < 11; ++a) {
-    for (auto b = -11; b < 11; ++b) {
-      auto choose_material = prng::get_real(0.0f, 1.0f);
-      auto af = static_cast<float>(a);
-      auto bf = static_cast<float>(b);
-      auto center = glm::vec3{af + 0.9f * prng::get_real(0.0f, 1.0f), 0.2f, bf + 0.9f * prng::get_real(0.0f, 1.0f)};
-
-      if (glm::length(center - glm::vec3{4.0f, 0.2f, 0.0f}) > 0.9f) {
-        std::shared_ptr<Material> sphere_material;
-        auto center2 = center;
-
-        if (choose_material < 0.8f) {
-          auto albedo = random_color() * random_color();
-          center2 += glm::vec3{0.0f, prng::get_real(0.0f, 0.5f), 0.0f};
-          sphere_material = std::make_shared<Lambertian>(albedo);
-        } else if (choose_material < 0.95f) {
-          auto albedo = random_color(0.5f, 1.0f);
-          auto fuzz = prng::get_real(0.0f, 0.5f);
-          sphere_material = std::make_shared<Metal>(albedo, fuzz);
-        } else {
-          sphere_material = std::make_shared<Dielectric>(1.5f);
-        }
-
-        auto sphere = std::make_shared<Sphere>(center, center2, 0.2f, sphere_material);
-        hittables.push_back(sphere);
-      }
+#include <map>
+#include <string>
+#include <span>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Writes the features next to the image, as <name>.albedo.ppm, <name>.normal.ppm and <name>.depth.ppm
+auto write_features(const std::string& output, const FeatureBuffers& features, const Region& region) -> void {
+  auto name = std::filesystem::path{output}.replace_extension().string();
+  auto max_depth = 0.0f;
+  for (auto y = region.y0; y < region.y1; ++y) {
+    for (auto x = region.x0; x < region.x1; ++x) {
+      max_depth = std::max(max_depth, features.depth[y * features.width + x]);
     }
   }
 
-  auto material1 = std::make_shared<Dielectric>(1.5f);
-  auto sphere1 = std::make_shared<Sphere>(glm::vec3{0.0f, 1.0f, 0.0f}, 1.0f, material1);
-  hittables.push_back(sphere1);
-
-  auto material2 = std::make_shared<Lambertian>(glm::vec3{0.4f, 0.2f, 0.1f});
-  auto sphere2 = std::make_shared<Sphere>(glm::vec3{-4.0f, 1.0f, 0.0f}, 1.0f, material2);
-  hittables.push_back(sphere2);
-
-  auto material3 = std::make_shared<Metal>(glm::vec3{0.7f, 0.6f, 0.5f}, 0.0f);
-  auto sphere3 = std::make_shared<Sphere>(glm::vec3{4.0f, 1.0f, 0.0f}, 1.0f, material3);
-  hittables.push_back(sphere3);
-
-  hittables = {std::make_shared<BvhNode>(hittables)};
-
-  auto options = RenderOptions{fov, num_samples, max_depth, look_from, look_at, focus_distance, defocus_angle};
-  render(ppm, options, hittables);
-}
-
-auto checkered_spheres() {
-  auto ppm = Ppm{"output.ppm", 700, 450};
-  constexpr auto fov = 20.0f * glm::pi<float>() / 180.0f;
-  constexpr auto num_samples = 50u;
-  constexpr auto max_depth = 8u;
-  constexpr auto look_from = glm::vec3{13.0f, 2.0f, 3.0f};
-  constexpr auto look_at = glm::vec3{0.0f, 0.0f, 0.0f};
-  constexpr auto defocus_angle = 0.0f;
-  auto focus_distance = 10.0f;
-
-  auto hittables = Hittables{};
-
-  auto checker = std::make_shared<CheckerTexture>(0.32f, glm::vec3{0.2f, 0.3f, 0.1f}, glm::vec3{0.9f, 0.9f, 0.9f});
-  auto material = std::make_shared<Lambertian>(checker);
-
-  auto sphere1 = std::make_shared<Sphere>(glm::vec3{0.0f, -10.0f, 0.0f}, 10.0f, material);
-  hittables.push_back(sphere1);
-
-  auto sphere2 = std::make_shared<Sphere>(glm::vec3{0.0f, 10.0f, 0.0f}, 10.0f, material);
-  hittables.push_back(sphere2);
-
-  hittables = {std::make_shared<BvhNode>(hittables)};
-
-  auto options = RenderOptions{fov, num_samples, max_depth, look_from, look_at, focus_distance, defocus_angle};
-  render(ppm, options, hittables);
-}
-
-auto world() {
-  auto ppm = Ppm{"output.ppm", 1000, 600};
-  
-  auto options = RenderOptions{};
-  options.fov = 20.0f * glm::pi<float>() / 180.0f;
-  options.num_samples = 100u;
-  options.max_depth = 8u;
-  options.look_from = glm::vec3{0.0f, 0.0f, 12.0f};
-  options.look_at = glm::vec3{0.0f, 0.0f, 0.0f};
-  options.defocus_angle = 0.0f;
-  options.focus_distance = 10.0f;
-
-  auto hittables = Hittables{};
-
-  auto texture = load_image("./assets/textures/earthmap.jpg");
-  if (!texture) {
-    std::cerr << "Failed to load texture\n";
-    return;
+  auto albedo = Ppm{name + ".albedo.ppm", region.width(), region.height()};
+  auto normal = Ppm{name + ".normal.ppm", region.width(), region.height()};
+  auto depth = Ppm{name + ".depth.ppm", region.width(), region.height()};
+  for (auto y = region.y0; y < region.y1; ++y) {
+    for (auto x = region.x0; x < region.x1; ++x) {
+      auto pixel = y * features.width + x;
+      albedo.write_color(features.albedo[pixel]);
+      normal.write_color(features.normal[pixel] * 0.5f + 0.5f);
+      depth.write_color(glm::vec3{max_depth > 0.0f ? features.depth[pixel] / max_depth : 0.0f});
+    }
   }
-
-  auto earth_material = std::make_shared<Lambertian>(std::make_shared<ImageTexture>(*texture));
-  auto earth = std::make_shared<Sphere>(glm::vec3{0.0f, 0.0f, 0.0f}, 2.0f, earth_material);
-  hittables.push_back(earth);
-
-  hittables = {std::make_shared<BvhNode>(hittables)};
-
-  render(ppm, options, hittables);
-}
-
-auto perlin_spheres() {
-  auto ppm = Ppm{"output.ppm", 1280, 720};
-  
-  auto options = RenderOptions{};
-  options.fov = 20.0f * glm::pi<float>() / 180.0f;
-  options.num_samples = 25u;
-  options.max_depth = 8u;
-  options.look_from = glm::vec3{13.0f, 2.0f, 3.0f};
-  options.look_at = glm::vec3{0.0f, 0.0f, 0.0f};
-  options.defocus_angle = 0.0f;
-  options.focus_distance = 10.0f;
-
-  auto hittables = Hittables{};
-
-  auto texture = std::make_shared<NoiseTexture>(2.0f);
-  auto material = std::make_shared<Lambertian>(texture);
-
-  auto sphere1 = std::make_shared<Sphere>(glm::vec3{0.0f, -1000.0f, 0.0f}, 1000.0f, material);
-  hittables.push_back(sphere1);
-
-  auto sphere2 = std::make_shared<Sphere>(glm::vec3{0.0f, 2.0f, 0.0f}, 2.0f, material);
-  hittables.push_back(sphere2);
-
-  hittables = {std::make_shared<BvhNode>(hittables)};
-
-  render(ppm, options, hittables);
-}
-
-auto quads() {
-  auto ppm = Ppm{"output.ppm", 500, 500};
-  
-  auto options = RenderOptions{};
-  options.fov = 80.0f * glm::pi<float>() / 180.0f;
-  options.num_samples = 50u;
-  options.max_depth = 20u;
-  options.look_from = glm::vec3{0.0f, 0.0f, 9.0f};
-  options.look_at = glm::vec3{0.0f, 0.0f, 0.0f};
-  options.defocus_angle = 0.0f;
-  options.focus_distance = 10.0f;
-
-  auto hittables = Hittables{};
-
-  auto back_material = std::make_shared<Lambertian>(glm::vec3{1.0f, 0.2f, 0.2f});
-  auto back_quad = std::make_shared<Quad>(glm::vec3{-2.0f, -2.0f, 0.0f}, glm::vec3{4.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 4.0f, 0.0f}, back_material);
-  hittables.push_back(back_quad);
-
-  auto left_material = std::make_shared<Lambertian>(glm::vec3{0.2f, 0.2f, 1.0f});
-  auto left_quad = std::make_shared<Quad>(glm::vec3{-2.0f, -2.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 4.0f}, glm::vec3{0.0f, 4.0f, 0.0f}, left_material);
-  hittables.push_back(left_quad);
-
-  auto right_material = std::make_shared<Lambertian>(glm::vec3{0.2f, 1.0f, 0.2f});
-  auto right_quad = std::make_shared<Quad>(glm::vec3{2.0f, -2.0f, 0.0f}, glm::vec3{0.0f, 4.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 4.0f}, right_material);
-  hittables.push_back(right_quad);
-
-  auto bottom_material = std::make_shared<Lambertian>(glm::vec3{1.0f, 1.0f, 1.0f});
-  auto bottom_quad = std::make_shared<Quad>(glm::vec3{-2.0f, -2.0f, 0.0f}, glm::vec3{4.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 4.0f}, bottom_material);
-  hittables.push_back(bottom_quad);
-
-  auto top_material = std::make_shared<Lambertian>(glm::vec3{0.5f, 0.0f, 0.5f});
-  auto top_quad = std::make_shared<Quad>(glm::vec3{-2.0f, 2.0f, 0.0f}, glm::vec3{4.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 4.0f}, top_material);
-  hittables.push_back(top_quad);
-
-  hittables = {std::make_shared<BvhNode>(hittables)};
-
-  render(ppm, options, hittables);
 }
 
-auto simple_light() {
-  auto hittables = Hittables{};
-
-  auto texture = std::make_shared<NoiseTexture>(2.0f);
-  auto material = std::make_shared<Lambertian>(texture);
-  auto sphere = std::make_shared<Sphere>(glm::vec3{0.0f, -1000.0f, 0.0f}, 1000.0f, material);
-  hittables.push_back(sphere);
-
-  auto material2 = std::make_shared<Metal>(glm::vec3{0.7f, 0.6f, 0.5f}, 0.2f);
-  auto sphere2 = std::make_shared<Sphere>(glm::vec3{0.0f, 2.0f, 0.0f}, 2.0f, material2);
-  hittables.push_back(sphere2);
-
-  auto checker = std::make_shared<CheckerTexture>(1.0f, glm::vec3{0.2f, 0.3f, 0.1f}, glm::vec3{0.9f, 0.9f, 0.9f});
-  auto material3 = std::make_shared<Lambertian>(checker);
-  auto sphere3 = std::make_shared<Sphere>(glm::vec3{-3.0f, 2.0f, 3.0f}, 2.0f, material3); 
-  hittables.push_back(sphere3);
-
-  auto light = std::make_shared<DiffuseLight>(glm::vec3{4.0f, 4.0f, 4.0f});
-  auto sphere4 = std::make_shared<Sphere>(glm::vec3{0.0f, 7.0f, 0.0f}, 2.0f, light);
-  hittables.push_back(sphere4);
-
-  auto quad = std::make_shared<Quad>(glm::vec3{3.0f, 1.0f, -2.0f}, glm::vec3{2.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 2.0f, 0.0f}, light);
-  hittables.push_back(quad);
-
-  hittables = {std::make_shared<BvhNode>(hittables)};
-
-  auto ppm = Ppm{"output.ppm", 800, 400};
-  auto options = RenderOptions{};
-  options.num_samples = 5000u;
-  options.max_depth = 10u;
-  options.fov = 20.0f * glm::pi<float>() / 180.0f;
-  options.look_from = glm::vec3{20.0f, 6.0f, 13.0f};
-  options.look_at = glm::vec3{0.0f, 2.0f, 0.0f};
-  options.background_color = glm::vec3{0.001f};
-
-  render(ppm, options, hittables);
+// Inserts the frame number before the extension, as in name.0042.ppm
+auto get_frame_path(const std::string& path, unsigned frame) -> std::string {
+  auto file_path = std::filesystem::path{path};
+  auto number = std::to_string(frame);
+  number.insert(0, number.size() < 4 ? 4 - number.size() : 0, '0');
+  return file_path.replace_extension().string() + "." + number + file_path.extension().string();
 }
 
-auto cornell_box() {
-  auto hittables = Hittables{};
-
-  auto red = std::make_shared<Lambertian>(glm::vec3{0.65f, 0.05f, 0.05f});
-  auto white = std::make_shared<Lambertian>(glm::vec3{0.73f});
-  auto green = std::make_shared<Lambertian>(glm::vec3{0.12f, 0.45f, 0.15f});
-  auto light = std::make_shared<DiffuseLight>(glm::vec3{15.0f});
-
-  auto left_wall = std::make_shared<Quad>(glm::vec3{555.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 555.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 555.0f}, green);
-  hittables.push_back(left_wall);
-
-  auto right_wall = std::make_shared<Quad>(glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 555.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 555.0f}, red);
-  hittables.push_back(right_wall);
-
-  auto light_quad = std::make_shared<Quad>(glm::vec3{343.0f, 554.0f, 332.0f}, glm::vec3{-130.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 0.0f, -105.0f}, light);
-  hittables.push_back(light_quad);
-
-  auto floor = std::make_shared<Quad>(glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{555.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 555.0f}, white);
-  hittables.push_back(floor);
-
-  auto ceiling = std::make_shared<Quad>(glm::vec3{555.0f, 555.0f, 555.0f}, glm::vec3{-555.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 0.0f, -555.0f}, white);
-  hittables.push_back(ceiling);
-
-  auto back_wall = std::make_shared<Quad>(glm::vec3{0.0f, 0.0f, 555.0f}, glm::vec3{555.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 555.0f, 0.0f}, white);
-  hittables.push_back(back_wall);
+// Renders the scene as it is and writes the image, or the partial result, to output
+auto render_image(const Scene& scene, const CommandLine& command_line, const std::string& output, const RenderHooks& hooks) -> bool {
+  auto region = get_region(scene.options, scene.width, scene.height);
+  auto image_hooks = hooks;
+  image_hooks.on_preview = [&](const Framebuffer& framebuffer, unsigned stride) {
+    if (!command_line.partial) {
+      auto ppm = Ppm{output, region.width(), region.height()};
+      write_image(ppm, framebuffer, region, stride);
+    }
+  };
 
-  auto box1 = get_box(glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{165.0f, 330.0f, 165.0f}, white);
-  for (auto& hittable : box1) {
-    hittable = {std::make_shared<RotateY>(hittable, 15.0f * glm::pi<float>() / 180.0f)};
-    hittable = {std::make_shared<Translate>(hittable, glm::vec3{265.0f, 0.0f, 295.0f})};
-    hittables.push_back(hittable);
+  auto rendered = render(scene.width, scene.height, scene.options, scene.hittables, image_hooks);
+  if (!rendered || (hooks.cancelled && *hooks.cancelled)) {
+    return false;
   }
-
-  auto box2 = get_box(glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{165.0f, 165.0f, 165.0f}, white);
-  for (auto& hittable : box2) {
-    hittable = {std::make_shared<RotateY>(hittable, -18.0f * glm::pi<float>() / 180.0f)};
-    hittable = {std::make_shared<Translate>(hittable, glm::vec3{130.0f, 0.0f, 65.0f})};
-    hittables.push_back(hittable);
+  const auto& framebuffer = *rendered;
+  if (command_line.partial) {
+    auto header = get_checkpoint_header(scene.options, scene.width, scene.height);
+    return write_checkpoint(output, header, framebuffer);
   }
 
-  hittables = {std::make_shared<BvhNode>(hittables)};
-
-  auto ppm = Ppm{"output.ppm", 600, 600};
-  auto options = RenderOptions{};
-  options.num_samples = 100u;
-  options.max_depth = 6u;
-  options.fov = 40.0f * glm::pi<float>() / 180.0f;
-  options.look_from = glm::vec3{278.0f, 278.0f, -800.0f};
-  options.look_at = glm::vec3{278.0f, 278.0f, 0.0f};
-  options.background_color = glm::vec3{0.0f};
+  auto features = FeatureBuffers{};
+  auto denoised = std::vector<glm::vec3>{};
+  if (command_line.denoise || command_line.features) {
+    auto phase = stats::ScopedPhase{stats::Phase::denoise};
+    features = render_features(scene.width, scene.height, scene.options, scene.hittables);
+    if (command_line.denoise) {
+      denoised = denoise(framebuffer, features, region);
+    }
+  }
 
-  render(ppm, options, hittables);
+  auto phase = stats::ScopedPhase{stats::Phase::output};
+  if (command_line.features) {
+    write_features(output, features, region);
+  }
+  auto ppm = Ppm{output, region.width(), region.height()};
+  if (command_line.denoise) {
+    write_image(ppm, denoised, framebuffer.width, region);
+  }
+  else {
+    write_image(ppm, framebuffer, region);
+  }
+  return true;
 }
 
-auto mesh() {
-  auto model = import_model("./assets/models/car/car.obj");
-  if (!model) {
-    std::cerr << "Failed to import model\n";
-    return;
+// Renders the image, or every frame of an animated scene
+auto render_frames(Scene& scene, const CommandLine& command_line, const RenderHooks& hooks) -> std::optional<unsigned> {
+  auto& animation = scene.animation;
+  if (animation.frame_begin == animation.frame_end) {
+    if (command_line.frames) {
+      std::cerr << "The scene " << command_line.scene << " is not animated\n";
+      return {};
+    }
+    if (!render_image(scene, command_line, command_line.output, hooks)) {
+      return {};
+    }
+    return 1u;
   }
-  
-  auto hitables = Hittables{};
 
-  for (auto& mesh : model->meshes) {
-    for (auto face : mesh.faces) {
-      hitables.push_back(face);
+  // the assets and the BVHs of the objects are kept between frames
+  auto [frame_begin, frame_end] = command_line.frames.value_or(std::pair{animation.frame_begin, animation.frame_end});
+  auto checkpoint_path = scene.options.checkpoint_path;
+  for (auto frame = frame_begin; frame < frame_end; ++frame) {
+    std::cout << "Frame " << frame << "\n";
+    scene.hittables = set_frame(animation, frame, scene.options);
+    if (!checkpoint_path.empty()) {
+      scene.options.checkpoint_path = get_frame_path(checkpoint_path, frame);
+    }
+    if (!render_image(scene, command_line, get_frame_path(command_line.output, frame), hooks)) {
+      return {};
     }
   }
 
-  auto checker = std::make_shared<CheckerTexture>(0.2f, glm::vec3{0.2f, 0.3f, 0.1f}, glm::vec3{0.9f, 0.9f, 0.9f});
-  auto material = std::make_shared<Lambertian>(checker);
-  auto ground = std::make_shared<Sphere>(glm::vec3{0.0f, -1000.0f, 0.0f}, 1000.0f, material);
-  hitables.push_back(ground);
-
-  auto light = std::make_shared<DiffuseLight>(glm::vec3{15.0f, 15.0f, 15.0f});
-  auto sphere = std::make_shared<Sphere>(glm::vec3{0.5f, 1.5f, -1.0f}, 0.5f, light);
-  hitables.push_back(sphere);
-
-  hitables = {std::make_shared<BvhNode>(hitables)};
-
-  auto ppm = Ppm{"output.ppm", 900, 600};
-  auto options = RenderOptions{};
-  options.num_samples = 30u;
-  options.max_depth = 6u;
-  options.fov = 30.0f * glm::pi<float>() / 180.0f;
-  options.look_from = glm::vec3{1.0f, 0.8f, 2.0f};
-  options.look_at = glm::vec3{0.0f, 0.2f, 0.0f};
-  options.background_color = glm::vec3{0.01f, 0.01f, 0.1f};
-
-  render(ppm, options, hitables);
-}
-
-auto cornell_smoke() {
-  auto hittables = Hittables{};
-
-  auto red = std::make_shared<Lambertian>(glm::vec3{0.65f, 0.05f, 0.05f});
-  auto white = std::make_shared<Lambertian>(glm::vec3{0.73f});
-  auto green = std::make_shared<Lambertian>(glm::vec3{0.12f, 0.45f, 0.15f});
-  auto light = std::make_shared<DiffuseLight>(glm::vec3{15.0f});
-
-  auto left_wall = std::make_shared<Quad>(glm::vec3{555.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 555.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 555.0f}, green);
-  hittables.push_back(left_wall);
-
-  auto right_wall = std::make_shared<Quad>(glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 555.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 555.0f}, red);
-  hittables.push_back(right_wall);
-
-  auto light_quad = std::make_shared<Quad>(glm::vec3{113.0f, 554.0f, 127.0f}, glm::vec3{330.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 305.0f}, light);
-  hittables.push_back(light_quad);
-
-  auto floor = std::make_shared<Quad>(glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{555.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 555.0f}, white);
-  hittables.push_back(floor);
-
-  auto ceiling = std::make_shared<Quad>(glm::vec3{555.0f, 555.0f, 555.0f}, glm::vec3{-555.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 0.0f, -555.0f}, white);
-  hittables.push_back(ceiling);
-
-  auto back_wall = std::make_shared<Quad>(glm::vec3{0.0f, 0.0f, 555.0f}, glm::vec3{555.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 555.0f, 0.0f}, white);
-  hittables.push_back(back_wall);
-
-  auto glass_sphere = std::make_shared<Sphere>(glm::vec3{130.0f, 90.0f, 100.0f}, 90.0f, std::make_shared<Dielectric>(1.5f));
-  hittables.push_back(glass_sphere);
-
-  auto sphere = std::make_shared<Sphere>(glm::vec3{420.0f, 90.0f, 295.0f}, 90.0f, white);
-  auto smoke = std::make_shared<ConstantMedium>(sphere, 0.01f, glm::vec3{0.0f});
-  hittables.push_back(smoke);
-
-  hittables = {std::make_shared<BvhNode>(hittables)};
-
-  auto ppm = Ppm{"output.ppm", 600, 600};
-  auto options = RenderOptions{};
-  options.num_samples = 50u;
-  options.max_depth = 15u;
-  options.fov = 40.0f * glm::pi<float>() / 180.0f;
-  options.look_from = glm::vec3{278.0f, 278.0f, -800.0f};
-  options.look_at = glm::vec3{278.0f, 278.0f, 0.0f};
-  options.background_color = glm::vec3{0.0f};
-
-  render(ppm, options, hittables);
+  return frame_end - frame_begin;
 }
 
-auto final_scene() {
-  auto hittables = Hittables{};
-
-  auto ground = std::make_shared<Lambertian>(glm::vec3{0.48f, 0.83f, 0.53f});
-
-  for (auto i = 0u; i < 20u; ++i) {
-    for (auto j = 0u; j < 20u; ++j) {
-      auto x0 = -1000.0f + static_cast<float>(i) * 100.0f;
-      auto z0 = -1000.0f + static_cast<float>(j) * 100.0f;
-      auto y0 = 0.0f;
-      auto x1 = x0 + 100.0f;
-      auto z1 = z0 + 100.0f;
-      auto y1 = prng::get_real(1.0f, 101.0f);
-
-      auto box = get_box(glm::vec3{x0, y0, z0}, glm::vec3{x1, y1, z1}, ground);
-      hittables.insert(hittables.end(), box.begin(), box.end());
+// Renders the scene with the options of the command line, and writes the statistics when asked to
+auto run(Scene& scene, const CommandLine& command_line, const RenderHooks& hooks = {}) -> bool {
+  apply_command_line(command_line, scene.options);
+
+  // the scene is accounted for before rendering, where its memory use is known
+  auto scene_peak_bytes = stats::peak_memory_bytes();
+  auto account = std::optional<memory::Account>{};
+  if (!command_line.memory_path.empty()) {
+    account = account_memory(scene);
+    if (command_line.denoise || command_line.features) {
+      auto pixels = std::uint64_t{scene.width} * scene.height;
+      account->add(memory::Category::framebuffer, pixels * (2 * sizeof(glm::vec3) + sizeof(float)));
     }
   }
 
-  auto light = std::make_shared<DiffuseLight>(glm::vec3{7.0f, 7.0f, 7.0f});
-  auto light_quad = std::make_shared<Quad>(glm::vec3{123.0f, 554.0f, 147.0f}, glm::vec3{300.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 265.0f}, light);
-  hittables.push_back(light_quad);
-
-  auto center1 = glm::vec3{400.0f, 400.0f, 200.0f};
-  auto center2 = center1 + glm::vec3{30.0f, 0.0f, 0.0f};
-  auto moving_sphere_material = std::make_shared<Lambertian>(glm::vec3{0.7f, 0.3f, 0.1f});
-  auto moving_sphere = std::make_shared<Sphere>(center1, center2, 50.0f, moving_sphere_material);
-  hittables.push_back(moving_sphere);
-
-  auto glass_sphere = std::make_shared<Sphere>(glm::vec3{260.0f, 150.0f, 45.0f}, 50.0f, std::make_shared<Dielectric>(1.5f));
-  hittables.push_back(glass_sphere);
-
-  auto metal_sphere = std::make_shared<Sphere>(glm::vec3{0.0f, 300.0f, 145.0f}, 50.0f, std::make_shared<Metal>(glm::vec3{0.8f, 0.8f, 0.9f}, 0.9f));
-  hittables.push_back(metal_sphere);
-
-  auto model = import_model("./assets/models/car/car.obj", 150.0f);
-  if (!model) {
-    std::cerr << "Failed to import model\n";
-    return;
+  auto num_frames = render_frames(scene, command_line, hooks);
+  if (!num_frames) {
+    return false;
   }
 
-  for (auto& mesh : model->meshes) {
-    for (auto face : mesh.faces) {
-      auto r = std::make_shared<RotateY>(face, 195.0f * glm::pi<float>() / 180.0f);
-      auto t = std::make_shared<Translate>(r, glm::vec3{100.0f, 120.0f, 55.0f});
-      hittables.push_back(t);
+  if (account) {
+    account->add(memory::Category::texture_cache, texture_cache::resident_bytes, texture_cache::resident_levels);
+    if (!memory::write_report(command_line.memory_path, *account, scene_peak_bytes)) {
+      return false;
     }
   }
 
-  auto boundary = std::make_shared<Sphere>(glm::vec3{360.0f, 150.0f, 145.0f}, 70.0f, std::make_shared<Dielectric>(1.5f));
-  hittables.push_back(boundary);
-  auto medium = std::make_shared<ConstantMedium>(boundary, 0.1f, glm::vec3{0.2f, 0.4f, 0.9f});
-  hittables.push_back(medium);
-  boundary = std::make_shared<Sphere>(glm::vec3{0.0f}, 5000.0f, std::make_shared<Dielectric>(1.5f));
-  medium = std::make_shared<ConstantMedium>(boundary, 0.0001f, glm::vec3{1.0f});
-  hittables.push_back(medium);
-
-  auto image = load_image("./assets/textures/earthmap.jpg");
-  if (!image) {
-    std::cerr << "Failed to load image\n";
-    return;
+  if (!command_line.stats_path.empty()) {
+    auto region = get_region(scene.options, scene.width, scene.height);
+    auto info = stats::ReportInfo{command_line.scene, region.width(), region.height(),
+                                  std::uint64_t{region.width()} * region.height() * *num_frames};
+    return stats::write_report(command_line.stats_path, info);
   }
+  return true;
+}
 
-  auto earth_material = std::make_shared<Lambertian>(std::make_shared<ImageTexture>(*image));
-  auto earth = std::make_shared<Sphere>(glm::vec3{400.0f, 200.0f, 400.0f}, 100.0f, earth_material);
-  hittables.push_back(earth);
-
-  auto perlin = std::make_shared<NoiseTexture>(0.1f);
-  auto perlin_material = std::make_shared<Lambertian>(perlin);
-  auto perlin_sphere = std::make_shared<Sphere>(glm::vec3{220.0f, 280.0f, 300.0f}, 80.0f, perlin_material);
-  hittables.push_back(perlin_sphere);
-
-  auto white = std::make_shared<Lambertian>(glm::vec3{0.73f});
-  auto spheres = Hittables{};
-  for (auto i = 0u; i < 250u; ++i) {
-    auto sphere = std::make_shared<Sphere>(
-      glm::vec3{prng::get_real(0.0f, 165.0f), 
-                prng::get_real(0.0f, 165.0f), 
-                prng::get_real(0.0f, 165.0f)}, 10.0f, white);
-    spheres.push_back(sphere);
+auto main(int argc, char* argv[]) -> int {
+  auto command_line = parse_command_line(std::span{argv, static_cast<std::size_t>(argc)});
+  if (!command_line) {
+    print_usage();
+    return 1;
   }
 
-  auto bvh_spheres = std::make_shared<BvhNode>(spheres);
-  auto r_spheres = std::make_shared<RotateY>(bvh_spheres, 15.0f * glm::pi<float>() / 180.0f);
-  auto t_spheres = std::make_shared<Translate>(r_spheres, glm::vec3{-100.0f, 270.0f, 395.0f});
-  hittables.push_back(t_spheres);
-
-  hittables = {std::make_shared<BvhNode>(hittables)};
-
-  auto ppm = Ppm{"output.ppm", 800, 800};
-  auto options = RenderOptions{};
-  options.num_samples = 5000u;
-  options.max_depth = 15u;
-  options.fov = 40.0f * glm::pi<float>() / 180.0f;
-  options.look_from = glm::vec3{478.0f, 278.0f, -600.0f};
-  options.look_at = glm::vec3{278.0f, 278.0f, 0.0f};
-  options.background_color = glm::vec3{0.0f};
-
-  render(ppm, options, hittables);
-}
-
-auto main() -> int {
-  // bouncing_spheres();
-  // checkered_spheres();
-  // world();
-  // perlin_spheres();
-  // quads();
-  // simple_light();
-  cornell_box();
-  // mesh();
-  // cornell_smoke();
-  // final_scene();
+  // the trace covers every job of a server, and is written when it stops
+  auto write_trace = [&](bool succeeded) {
+    if (!command_line->trace_path.empty() && !tracing::write(command_line->trace_path)) {
+      return 1;
+    }
+    return succeeded ? 0 : 1;
+  };
+  if (!command_line->trace_path.empty()) {
+    tracing::start();
+  }
+  if (command_line->counters) {
+    counters::start();
+  }
+  // shared by every job of a server
+  if (command_line->texture_cache) {
+    texture_cache::set_budget(std::size_t{*command_line->texture_cache} << 20);
+  }
 
-  // auto a = 0.0f;
-  // auto b = 2.0f;
-  // auto sum = 0.0f;
-  // auto samples = 1000000u;
+  if (!command_line->server_socket.empty()) {
+    // scenes stay loaded between jobs, each job renders a copy so that its options stay its own
+    auto scenes = std::map<std::string, Scene>{};
+    auto run_job = [&scenes](const CommandLine& job, const RenderHooks& hooks) {
+      stats::reset();
+      auto it = scenes.find(job.scene);
+      if (it == scenes.end()) {
+        auto scene = load_scene(job.scene);
+        if (!scene) {
+          return false;
+        }
+        it = scenes.emplace(job.scene, std::move(*scene)).first;
+      }
+      auto scene = it->second;
+      return run(scene, job, hooks);
+    };
+    return write_trace(serve(command_line->server_socket, run_job));
+  }
 
-  // for (auto i = 0u; i < samples; ++i) {
-  //   auto x = prng::get_real(a, b);
-  //   sum += x * x;
-  // }
+  auto scene = load_scene(command_line->scene);
+  if (!scene) {
+    return write_trace(false);
+  }
 
-  // std::cout << "area(x^2, 0, 2) = " << (b - a) * sum / static_cast<float>(samples) << '\n';
+  // the copies are only of the scene as it is, animated scenes are built again every frame
+  if (command_line->numa_replicate && scene->animation.frame_begin == scene->animation.frame_end) {
+    auto build = [&]() -> std::optional<Hittables> {
+      auto copy = load_scene(command_line->scene);
+      return copy ? std::optional{copy->hittables} : std::nullopt;
+    };
+    if (!numa::replicate(scene->hittables, build)) {
+      return write_trace(false);
+    }
+  }
 
-  return 0;
+  return write_trace(run(*scene, *command_line));
 }
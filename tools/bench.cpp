@@ -0,0 +1,590 @@
+// Measures the intersection, traversal and shading kernels on their own, with inputs drawn
+// from a fixed seed so that two builds time the same work. Run it from the repository root,
+// the mesh benchmarks load the car model from ./assets.
+//
+//   ray-tracer-bench [--filter text] [--repetitions n] [--counters] [--json file]
+//   ray-tracer-bench --compare old.json new.json
+//   ray-tracer-bench --scaling <scene> [--threads 1,2,4] [--numa]
+//   ray-tracer-bench --accuracy
+
+#include "scenes.hpp"
+#include "renderer.hpp"
+#include "command-line.hpp"
+#include "perlin.hpp"
+#include "timer.hpp"
+#include "counters.hpp"
+#include "math.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Results are added up here so that the compiler cannot drop the work being timed
+volatile std::uint64_t g_sink{};
+
+constexpr auto g_seed = 1234u;
+constexpr auto g_num_inputs = 4096u;
+
+struct Benchmark {
+  std::string name{};
+  // ops per run, every op is one ray, or one evaluation
+  std::uint64_t ops{};
+  // returns a checksum of the results
+  std::function<std::uint64_t()> run{};
+};
+
+struct Result {
+  std::string name{};
+  double ns_per_op{};
+  double ops_per_second{};
+  // hardware counters per op, with --counters
+  std::optional<std::array<double, counters::event_names.size()>> counters_per_op{};
+};
+
+auto to_checksum(const std::optional<HitRecord>& hit_record) -> std::uint64_t {
+  return hit_record ? static_cast<std::uint64_t>(hit_record->distance * 1024.0f) + 1u : 0u;
+}
+
+// Rays starting on a sphere of the given radius around the origin, aimed at points inside
+// a smaller one, so that most of them hit what sits at the origin
+auto random_rays(float radius, float target_radius) -> std::vector<Ray> {
+  prng::set_seed(g_seed);
+  auto rays = std::vector<Ray>{};
+  rays.reserve(g_num_inputs);
+  for (auto i = 0u; i < g_num_inputs; ++i) {
+    auto origin = prng::get_unit_vector() * radius;
+    auto target = prng::get_unit_vector() * prng::get_real(0.0f, target_radius);
+    rays.emplace_back(origin, glm::normalize(target - origin));
+  }
+  return rays;
+}
+
+// One ray per pixel of a grid spread over the image of the scene
+auto camera_rays(const Scene& scene) -> std::vector<Ray> {
+  auto camera = make_camera(scene.options, scene.width, scene.height);
+  auto sampler = IndependentSampler{g_seed};
+  auto rays = std::vector<Ray>{};
+  rays.reserve(g_num_inputs);
+  for (auto i = 0u; i < g_num_inputs; ++i) {
+    auto x = static_cast<unsigned>(prng::hash(i, 0u) % scene.width);
+    auto y = static_cast<unsigned>(prng::hash(i, 1u) % scene.height);
+    rays.push_back(get_camera_ray(camera, sampler, x, y, 0u));
+  }
+  return rays;
+}
+
+template <typename Object>
+auto hit_benchmark(const std::string& name, std::shared_ptr<Object> object, std::vector<Ray> rays) -> Benchmark {
+  return Benchmark{name, rays.size(), [object, rays] {
+    auto checksum = std::uint64_t{};
+    for (const auto& ray : rays) {
+      checksum += to_checksum(object->hit(ray, 0.0f, g_max_float));
+    }
+    return checksum;
+  }};
+}
+
+auto scene_benchmark(const std::string& name) -> std::optional<Benchmark> {
+  prng::set_seed(g_seed);
+  auto scene = load_scene(name);
+  if (!scene) {
+    return {};
+  }
+  auto rays = camera_rays(*scene);
+  return Benchmark{"bvh/" + name, rays.size(), [hittables = scene->hittables, rays] {
+    auto checksum = std::uint64_t{};
+    for (const auto& ray : rays) {
+      checksum += to_checksum(trace(ray, hittables));
+    }
+    return checksum;
+  }};
+}
+
+auto scatter_benchmark(const std::string& name, std::shared_ptr<Material> material) -> Benchmark {
+  // the hits of random rays on a unit sphere
+  auto sphere = std::make_shared<Sphere>(glm::vec3{0.0f}, 1.0f, material);
+  auto rays = std::vector<Ray>{};
+  auto hit_records = std::vector<HitRecord>{};
+  for (const auto& ray : random_rays(4.0f, 0.9f)) {
+    auto hit_record = sphere->hit(ray, 0.0f, g_max_float);
+    if (hit_record) {
+      rays.push_back(ray);
+      hit_records.push_back(*hit_record);
+    }
+  }
+
+  return Benchmark{"scatter/" + name, rays.size(), [material, rays, hit_records] {
+    sampling::independent = IndependentSampler{g_seed};
+    sampling::independent.start_pixel_sample(0u, 0u, 0u);
+    auto checksum = std::uint64_t{};
+    for (auto i = 0uz; i < rays.size(); ++i) {
+      auto scatter_data = material->scatter(rays[i], hit_records[i]);
+      if (scatter_data) {
+        checksum += static_cast<std::uint64_t>(glm::dot(scatter_data->scattered.direction(), glm::vec3{1.0f}) * 1024.0f + 4096.0f);
+      }
+    }
+    return checksum;
+  }};
+}
+
+// Evaluates the function on pairs of inputs drawn in [min, max), in a loop the compiler may vectorize
+template <typename Function>
+auto math_benchmark(const std::string& name, float min, float max, Function function) -> Benchmark {
+  prng::set_seed(g_seed);
+  auto a = std::vector<float>(g_num_inputs);
+  auto b = std::vector<float>(g_num_inputs);
+  for (auto i = 0u; i < g_num_inputs; ++i) {
+    a[i] = prng::get_real(min, max);
+    b[i] = prng::get_real(min, max);
+  }
+  return Benchmark{"math/" + name, a.size(), [a, b, function, results = std::vector<float>(a.size())]() mutable {
+    for (auto i = 0uz; i < a.size(); ++i) {
+      results[i] = function(a[i], b[i]);
+    }
+    auto checksum = std::uint64_t{};
+    for (auto result : results) {
+      checksum += std::bit_cast<std::uint32_t>(result);
+    }
+    return checksum;
+  }};
+}
+
+auto make_benchmarks() -> std::vector<Benchmark> {
+  auto benchmarks = std::vector<Benchmark>{};
+  auto material = std::make_shared<Lambertian>(glm::vec3{0.5f});
+
+  {
+    auto box = Aabb{glm::vec3{-1.0f}, glm::vec3{1.0f}};
+    auto rays = random_rays(4.0f, 1.5f);
+    benchmarks.push_back(Benchmark{"aabb", rays.size(), [box, rays] {
+      auto checksum = std::uint64_t{};
+      for (const auto& ray : rays) {
+        checksum += box.hit(ray, 0.0f, g_max_float) ? 1u : 0u;
+      }
+      return checksum;
+    }});
+  }
+
+  benchmarks.push_back(hit_benchmark("sphere", std::make_shared<Sphere>(glm::vec3{0.0f}, 1.0f, material), random_rays(4.0f, 1.5f)));
+
+  auto triangle = std::make_shared<Triangle>(
+    glm::vec3{-1.0f, -1.0f, 0.0f}, glm::vec3{1.0f, -1.0f, 0.0f}, glm::vec3{0.0f, 1.0f, 0.0f},
+    glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec3{0.0f, 0.0f, 1.0f},
+    glm::vec2{0.0f, 0.0f}, glm::vec2{1.0f, 0.0f}, glm::vec2{0.5f, 1.0f}, material);
+  benchmarks.push_back(hit_benchmark("triangle", triangle, random_rays(4.0f, 1.5f)));
+
+  auto quad = std::make_shared<Quad>(glm::vec3{-1.0f, -1.0f, 0.0f}, glm::vec3{2.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 2.0f, 0.0f}, material);
+  benchmarks.push_back(hit_benchmark("quad", quad, random_rays(4.0f, 1.5f)));
+
+  for (const auto& name : {"bouncing_spheres", "cornell_box", "mesh"}) {
+    auto benchmark = scene_benchmark(name);
+    if (benchmark) {
+      benchmarks.push_back(std::move(*benchmark));
+    }
+    else {
+      std::cerr << "Skipping the " << name << " scene\n";
+    }
+  }
+
+  {
+    prng::set_seed(g_seed);
+    auto perlin = std::make_shared<Perlin>();
+    auto points = std::vector<glm::vec3>{};
+    for (auto i = 0u; i < g_num_inputs; ++i) {
+      points.push_back(prng::get_unit_vector() * prng::get_real(0.0f, 16.0f));
+    }
+    benchmarks.push_back(Benchmark{"perlin/turb", points.size(), [perlin, points] {
+      auto checksum = std::uint64_t{};
+      for (const auto& point : points) {
+        checksum += static_cast<std::uint64_t>(perlin->turb(point) * 1024.0f);
+      }
+      return checksum;
+    }});
+  }
+
+  benchmarks.push_back(scatter_benchmark("lambertian", material));
+  benchmarks.push_back(scatter_benchmark("lambertian/checker", std::make_shared<Lambertian>(std::make_shared<CheckerTexture>(0.2f, glm::vec3{0.2f, 0.3f, 0.1f}, glm::vec3{0.9f}))));
+  benchmarks.push_back(scatter_benchmark("metal", std::make_shared<Metal>(glm::vec3{0.8f}, 0.3f)));
+  benchmarks.push_back(scatter_benchmark("dielectric", std::make_shared<Dielectric>(1.5f)));
+
+  // the standard functions and their approximations, whichever the renderer was built with
+  auto two_pi = 2.0f * glm::pi<float>();
+  benchmarks.push_back(math_benchmark("sin/std", 0.0f, two_pi, [](float x, float) { return std::sin(x); }));
+  benchmarks.push_back(math_benchmark("sin/fast", 0.0f, two_pi, [](float x, float) { return math::fast::cos_sin(x).y; }));
+  benchmarks.push_back(math_benchmark("acos/std", -1.0f, 1.0f, [](float x, float) { return std::acos(x); }));
+  benchmarks.push_back(math_benchmark("acos/fast", -1.0f, 1.0f, [](float x, float) { return math::fast::acos(x); }));
+  benchmarks.push_back(math_benchmark("atan2/std", -1.0f, 1.0f, [](float y, float x) { return std::atan2(y, x); }));
+  benchmarks.push_back(math_benchmark("atan2/fast", -1.0f, 1.0f, [](float y, float x) { return math::fast::atan2(y, x); }));
+  benchmarks.push_back(math_benchmark("log/std", 1e-6f, 1.0f, [](float x, float) { return std::log(x); }));
+  benchmarks.push_back(math_benchmark("log/fast", 1e-6f, 1.0f, [](float x, float) { return math::fast::log(x); }));
+  benchmarks.push_back(math_benchmark("gamma/std", 0.0f, 4.0f, [](float x, float) { return std::pow(x, 1.0f / 2.2f); }));
+  benchmarks.push_back(math_benchmark("gamma/fast", 0.0f, 4.0f, [](float x, float) { return math::fast::pow(x, 1.0f / 2.2f); }));
+  benchmarks.push_back(math_benchmark("pow5/std", 0.0f, 1.0f, [](float x, float) { return std::pow(x, 5.0f); }));
+  benchmarks.push_back(math_benchmark("pow5/fast", 0.0f, 1.0f, [](float x, float) { return math::fast::pow5(x); }));
+
+  return benchmarks;
+}
+
+// Runs the benchmark until a repetition lasts long enough to time, and keeps the median
+auto measure(const Benchmark& benchmark, unsigned repetitions) -> Result {
+  constexpr auto min_milliseconds = 20.0;
+
+  auto runs = 1u;
+  while (true) {
+    auto timer = Timer{};
+    for (auto i = 0u; i < runs; ++i) {
+      g_sink = g_sink + benchmark.run();
+    }
+    if (timer.elapsed() >= min_milliseconds || runs >= (1u << 20)) {
+      break;
+    }
+    runs *= 2u;
+  }
+
+  auto counters_begin = counters::enabled ? counters::thread_counters().read_values() : std::nullopt;
+  auto times = std::vector<double>{};
+  for (auto repetition = 0u; repetition < repetitions; ++repetition) {
+    auto timer = Timer{};
+    for (auto i = 0u; i < runs; ++i) {
+      g_sink = g_sink + benchmark.run();
+    }
+    times.push_back(timer.elapsed());
+  }
+  auto counters_end = counters_begin ? counters::thread_counters().read_values() : std::nullopt;
+  std::ranges::sort(times);
+
+  auto ops = static_cast<double>(runs * std::max(benchmark.ops, std::uint64_t{1}));
+  auto ns_per_op = times[times.size() / 2] * 1e6 / ops;
+  auto result = Result{benchmark.name, ns_per_op, 1e9 / ns_per_op};
+  if (counters_end) {
+    result.counters_per_op.emplace();
+    for (auto event = 0uz; event < counters::event_names.size(); ++event) {
+      (*result.counters_per_op)[event] = static_cast<double>((*counters_end)[event] - (*counters_begin)[event]) / (ops * repetitions);
+    }
+  }
+  return result;
+}
+
+// The columns of the counters that could be opened
+auto print_counters(const Result& result) -> void {
+  for (auto event = 0uz; event < counters::event_names.size(); ++event) {
+    if (counters::is_available(static_cast<counters::Event>(event))) {
+      std::cout << std::setw(16) << std::setprecision(2) << (result.counters_per_op ? (*result.counters_per_op)[event] : 0.0);
+    }
+  }
+}
+
+auto write_json(const std::string& path, const std::vector<Result>& results) -> bool {
+  auto file = std::ofstream{path};
+  if (!file) {
+    std::cerr << "[ERROR] Failed to open " << path << "\n";
+    return false;
+  }
+  // one benchmark per line, which is what read_json expects
+  file << "{\n  \"benchmarks\": [\n";
+  for (auto i = 0uz; i < results.size(); ++i) {
+    file << "    {\"name\": \"" << results[i].name << "\", \"ns_per_op\": " << results[i].ns_per_op
+         << ", \"ops_per_second\": " << results[i].ops_per_second;
+    for (auto event = 0uz; results[i].counters_per_op && event < counters::event_names.size(); ++event) {
+      if (counters::is_available(static_cast<counters::Event>(event))) {
+        file << ", \"" << counters::event_names[event] << "_per_op\": " << (*results[i].counters_per_op)[event];
+      }
+    }
+    file << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  file << "  ]\n}\n";
+  return static_cast<bool>(file);
+}
+
+// Reads the ns/op of every benchmark of a file written by write_json
+auto read_json(const std::string& path) -> std::optional<std::map<std::string, double>> {
+  auto file = std::ifstream{path};
+  if (!file) {
+    std::cerr << "[ERROR] Failed to open " << path << "\n";
+    return {};
+  }
+
+  auto results = std::map<std::string, double>{};
+  for (auto line = std::string{}; std::getline(file, line);) {
+    constexpr auto name_key = std::string_view{"\"name\": \""};
+    constexpr auto time_key = std::string_view{"\"ns_per_op\": "};
+    auto name_begin = line.find(name_key);
+    auto time_begin = line.find(time_key);
+    if (name_begin == std::string::npos || time_begin == std::string::npos) {
+      continue;
+    }
+    name_begin += name_key.size();
+    auto name = line.substr(name_begin, line.find('"', name_begin) - name_begin);
+    time_begin += time_key.size();
+    auto ns_per_op = parse_number<double>(line.substr(time_begin, line.find(',', time_begin) - time_begin));
+    if (!ns_per_op) {
+      std::cerr << "[ERROR] Invalid line in " << path << ": " << line << "\n";
+      return {};
+    }
+    results[name] = *ns_per_op;
+  }
+  return results;
+}
+
+// Prints how much slower, above 1, or faster, below 1, every benchmark got
+auto compare(const std::string& old_path, const std::string& new_path) -> bool {
+  auto old_results = read_json(old_path);
+  auto new_results = read_json(new_path);
+  if (!old_results || !new_results) {
+    return false;
+  }
+
+  std::cout << std::left << std::setw(24) << "benchmark" << std::right << std::setw(12) << "old ns/op"
+            << std::setw(12) << "new ns/op" << std::setw(10) << "ratio" << "\n";
+  for (const auto& [name, new_time] : *new_results) {
+    auto it = old_results->find(name);
+    if (it == old_results->end()) {
+      continue;
+    }
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << it->second << std::setw(12) << new_time
+              << std::setw(10) << std::setprecision(3) << new_time / it->second << "\n";
+  }
+  return true;
+}
+
+// Renders the scene with each number of threads and prints the samples taken per second.
+// With numa, the threads are pinned and the framebuffer placed by NUMA node.
+auto scaling(const std::string& name, const std::vector<unsigned>& thread_counts, bool numa) -> bool {
+  constexpr auto samples = 4u;
+
+  auto scene = load_scene(name);
+  if (!scene) {
+    return false;
+  }
+  scene->options.num_samples = samples;
+  scene->options.numa = numa;
+
+  auto results = std::vector<std::pair<unsigned, double>>{};
+  for (auto threads : thread_counts) {
+#ifdef _OPENMP
+    omp_set_num_threads(static_cast<int>(threads));
+#endif
+    auto timer = Timer{};
+    render(scene->width, scene->height, scene->options, scene->hittables);
+    auto seconds = timer.elapsed() / 1000.0;
+    results.emplace_back(threads, static_cast<double>(scene->width) * scene->height * samples / seconds);
+  }
+
+  std::cout << std::right << std::setw(8) << "threads" << std::setw(16) << "samples/s" << std::setw(10) << "speedup"
+            << std::setw(12) << "efficiency" << "\n";
+  for (const auto& [threads, throughput] : results) {
+    auto speedup = throughput / results.front().second * results.front().first;
+    std::cout << std::setw(8) << threads << std::fixed << std::setprecision(0) << std::setw(16) << throughput
+              << std::setprecision(2) << std::setw(10) << speedup << std::setw(12) << speedup / threads << "\n";
+  }
+  return true;
+}
+
+struct AccuracyCheck {
+  std::string name{};
+  float min{};
+  float max{};
+  // the largest error allowed, relative to the exact value when relative is set
+  double max_error{};
+  bool relative{};
+  // the exact value, computed in double precision, and the approximation at a point of [min, max]
+  std::function<std::array<double, 2>(float)> evaluate{};
+};
+
+// Compares every approximation of math.hpp to the standard function on an even grid of its
+// domain, and prints the largest errors. Returns false if one is above what math.hpp states.
+auto check_accuracy() -> bool {
+  constexpr auto points = 1u << 22;
+  auto checks = std::vector<AccuracyCheck>{
+    {"cos", -8.0f * glm::pi<float>(), 8.0f * glm::pi<float>(), 3e-7, false, [](float x) {
+      return std::array{std::cos(double{x}), double{math::fast::cos_sin(x).x}};
+    }},
+    {"sin", -8.0f * glm::pi<float>(), 8.0f * glm::pi<float>(), 3e-7, false, [](float x) {
+      return std::array{std::sin(double{x}), double{math::fast::cos_sin(x).y}};
+    }},
+    {"sin", -1e4f, 1e4f, 3e-7, false, [](float x) {
+      return std::array{std::sin(double{x}), double{math::fast::cos_sin(x).y}};
+    }},
+    {"acos", -1.0f, 1.0f, 5e-7, false, [](float x) {
+      return std::array{std::acos(double{x}), double{math::fast::acos(x)}};
+    }},
+    // around the unit circle, the argument is the angle
+    {"atan2", -glm::pi<float>(), glm::pi<float>(), 5e-7, false, [](float angle) {
+      auto y = std::sin(angle);
+      auto x = std::cos(angle);
+      return std::array{std::atan2(double{y}, double{x}), double{math::fast::atan2(y, x)}};
+    }},
+    {"log", 0.5f, 2.0f, 2e-7, false, [](float x) {
+      return std::array{std::log(double{x}), double{math::fast::log(x)}};
+    }},
+    {"log", 1e-30f, 0.5f, 1e-6, true, [](float x) {
+      return std::array{std::log(double{x}), double{math::fast::log(x)}};
+    }},
+    {"log", 2.0f, 1e30f, 1e-6, true, [](float x) {
+      return std::array{std::log(double{x}), double{math::fast::log(x)}};
+    }},
+    {"exp", -87.0f, 88.0f, 5e-7, true, [](float x) {
+      return std::array{std::exp(double{x}), double{math::fast::exp(x)}};
+    }},
+    {"gamma", 1e-6f, 64.0f, 1e-6, true, [](float x) {
+      return std::array{std::pow(double{x}, double{1.0f / 2.2f}), double{math::fast::pow(x, 1.0f / 2.2f)}};
+    }},
+    {"pow5", 0.0f, 1.0f, 5e-7, true, [](float x) {
+      return std::array{std::pow(double{x}, 5.0), double{math::fast::pow5(x)}};
+    }},
+  };
+
+  auto passed = true;
+  std::cout << std::left << std::setw(8) << "function" << std::right << std::setw(14) << "min" << std::setw(14) << "max"
+            << std::setw(12) << "error" << std::setw(12) << "bound" << "\n";
+  for (const auto& check : checks) {
+    auto max_error = 0.0;
+    for (auto i = 0u; i < points; ++i) {
+      auto t = (static_cast<double>(i) + 0.5) / points;
+      auto x = static_cast<float>(double{check.min} + t * (double{check.max} - double{check.min}));
+      auto [exact, approximation] = check.evaluate(x);
+      auto error = std::abs(approximation - exact);
+      if (check.relative) {
+        error /= std::max(std::abs(exact), 1e-300);
+      }
+      // also catches NaN
+      if (!(error <= max_error)) {
+        max_error = std::isnan(error) ? std::numeric_limits<double>::infinity() : error;
+      }
+    }
+    auto ok = max_error <= check.max_error;
+    passed = passed && ok;
+    std::cout << std::left << std::setw(8) << check.name << std::right << std::scientific << std::setprecision(2)
+              << std::setw(14) << check.min << std::setw(14) << check.max << std::setw(12) << max_error
+              << std::setw(12) << check.max_error << (check.relative ? " rel" : " abs") << (ok ? "" : "  FAILED") << "\n";
+  }
+  std::cout << std::defaultfloat;
+  return passed;
+}
+
+auto main(int argc, char* argv[]) -> int {
+  auto args = std::span{argv, static_cast<std::size_t>(argc)}.subspan(1);
+  auto filter = std::string{};
+  auto json_path = std::string{};
+  auto repetitions = 9u;
+  auto scaling_scene = std::string{};
+  auto thread_counts = std::vector<unsigned>{};
+  auto numa = false;
+
+  for (auto i = 0uz; i < args.size(); ++i) {
+    auto arg = std::string{args[i]};
+    auto has_value = i + 1 < args.size();
+    if (arg == "--compare" && i + 2 < args.size()) {
+      return compare(args[i + 1], args[i + 2]) ? 0 : 1;
+    }
+    else if (arg == "--filter" && has_value) {
+      filter = args[++i];
+    }
+    else if (arg == "--json" && has_value) {
+      json_path = args[++i];
+    }
+    else if (arg == "--counters") {
+      counters::start();
+    }
+    else if (arg == "--accuracy") {
+      return check_accuracy() ? 0 : 1;
+    }
+    else if (arg == "--scaling" && has_value) {
+      scaling_scene = args[++i];
+    }
+    else if (arg == "--numa") {
+      numa = true;
+    }
+    else if (arg == "--threads" && has_value) {
+      auto text = std::string_view{args[++i]};
+      while (!text.empty()) {
+        auto comma = std::min(text.find(','), text.size());
+        auto threads = parse_number<unsigned>(text.substr(0, comma));
+        if (!threads || *threads == 0) {
+          std::cerr << "Invalid thread count in " << args[i] << "\n";
+          return 1;
+        }
+        thread_counts.push_back(*threads);
+        text.remove_prefix(std::min(comma + 1, text.size()));
+      }
+    }
+    else if (arg == "--repetitions" && has_value) {
+      auto value = parse_number<unsigned>(args[++i]);
+      if (!value || *value == 0) {
+        std::cerr << "Invalid number of repetitions\n";
+        return 1;
+      }
+      repetitions = *value;
+    }
+    else {
+      std::cerr << "Usage: ray-tracer-bench [--filter text] [--repetitions n] [--counters] [--json file]\n"
+                << "       ray-tracer-bench --compare old.json new.json\n"
+                << "       ray-tracer-bench --scaling <scene> [--threads 1,2,4] [--numa]\n"
+                << "       ray-tracer-bench --accuracy\n";
+      return 1;
+    }
+  }
+
+  if (!scaling_scene.empty()) {
+    if (thread_counts.empty()) {
+      for (auto threads = 1u; threads < std::thread::hardware_concurrency(); threads *= 2) {
+        thread_counts.push_back(threads);
+      }
+      thread_counts.push_back(std::max(std::thread::hardware_concurrency(), 1u));
+    }
+    return scaling(scaling_scene, thread_counts, numa) ? 0 : 1;
+  }
+
+  auto benchmarks = make_benchmarks();
+  if (counters::enabled) {
+    // opens the counters, so that the header only shows the available ones
+    counters::thread_counters();
+  }
+
+  auto results = std::vector<Result>{};
+  std::cout << std::left << std::setw(24) << "benchmark" << std::right << std::setw(12) << "ns/op"
+            << std::setw(16) << "ops/s";
+  for (auto event = 0uz; counters::enabled && event < counters::event_names.size(); ++event) {
+    if (counters::is_available(static_cast<counters::Event>(event))) {
+      std::cout << std::setw(16) << counters::event_names[event];
+    }
+  }
+  std::cout << "\n";
+  for (const auto& benchmark : benchmarks) {
+    if (benchmark.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    auto result = measure(benchmark, repetitions);
+    std::cout << std::left << std::setw(24) << result.name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << result.ns_per_op << std::setw(16) << std::setprecision(0) << result.ops_per_second;
+    print_counters(result);
+    std::cout << "\n";
+    results.push_back(result);
+  }
+
+  if (!json_path.empty() && !write_json(json_path, results)) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,61 @@
+// Sends one request to a render server started with --serve and prints the reply.
+// Usage: ray-tracer-client <socket> <request>...
+// Example: ray-tracer-client /tmp/rt.sock submit 5 cornell_box --samples 64 --output box.ppm
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <span>
+#include <string>
+
+auto main(int argc, char* argv[]) -> int {
+  auto args = std::span{argv, static_cast<std::size_t>(argc)};
+  if (args.size() < 3) {
+    std::cerr << "Usage: ray-tracer-client <socket> <request>...\n";
+    return 1;
+  }
+
+  auto socket_path = std::string{args[1]};
+  auto address = sockaddr_un{};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "[ERROR] The socket path " << socket_path << " is too long\n";
+    return 1;
+  }
+  std::copy(socket_path.begin(), socket_path.end(), address.sun_path);
+
+  auto server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0 || connect(server, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+    std::cerr << "Could not connect to " << socket_path << '\n';
+    return 1;
+  }
+
+  auto request = std::string{};
+  for (auto i = 2uz; i < args.size(); ++i) {
+    request += (i > 2 ? " " : "") + std::string{args[i]};
+  }
+  request += '\n';
+  for (auto written = 0uz; written < request.size();) {
+    auto count = write(server, request.data() + written, request.size() - written);
+    if (count <= 0) {
+      std::cerr << "Could not send the request\n";
+      close(server);
+      return 1;
+    }
+    written += static_cast<std::size_t>(count);
+  }
+
+  auto reply = std::string{};
+  auto buffer = std::array<char, 1024>{};
+  for (auto count = read(server, buffer.data(), buffer.size()); count > 0; count = read(server, buffer.data(), buffer.size())) {
+    reply.append(buffer.data(), static_cast<std::size_t>(count));
+  }
+  close(server);
+
+  std::cout << reply;
+  return reply.starts_with("error") ? 1 : 0;
+}
@@ -0,0 +1,301 @@
+// Renders scenes for a series of time budgets and measures the error of each image against a
+// reference, which gives the error reached in a given time. A missing reference is rendered
+// first and stored in the reference directory. Options after the ones below, like --sampler,
+// --seed or --integrator, apply to the timed renders and to the references.
+// Run it from the repository root, the scenes load their assets from ./assets.
+//
+//   ray-tracer-converge <reference directory> [--scenes a,b] [--budgets 1,2,4] [--reference-samples n]
+//                       [--json file] [render options]
+
+#include "scenes.hpp"
+#include "renderer.hpp"
+#include "checkpoint.hpp"
+#include "command-line.hpp"
+#include "timer.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+struct ImageError {
+  double rmse{};
+  double relative_mse{};
+  double flip{};
+};
+
+struct Measurement {
+  std::string scene{};
+  float budget{};
+  double seconds{};
+  unsigned samples{};
+  ImageError error{};
+};
+
+// CIELAB with a D65 white, from linear sRGB clamped to what a display shows
+auto to_lab(const glm::vec3& color) -> glm::vec3 {
+  auto c = glm::clamp(color, 0.0f, 1.0f);
+  auto xyz = glm::vec3{
+    0.4124f * c.r + 0.3576f * c.g + 0.1805f * c.b,
+    0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b,
+    0.0193f * c.r + 0.1192f * c.g + 0.9505f * c.b,
+  } / glm::vec3{0.9505f, 1.0f, 1.089f};
+  auto f = [](float t) {
+    return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+  };
+  auto fx = f(xyz.x);
+  auto fy = f(xyz.y);
+  auto fz = f(xyz.z);
+  return glm::vec3{116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz)};
+}
+
+// Blurs with a 5x5 binomial kernel, which stands for the loss of detail of the eye
+auto blur(const std::vector<glm::vec3>& image, unsigned width, unsigned height) -> std::vector<glm::vec3> {
+  constexpr auto kernel = std::array{1.0f, 4.0f, 6.0f, 4.0f, 1.0f};
+  auto horizontal = std::vector<glm::vec3>(image.size());
+  auto result = std::vector<glm::vec3>(image.size());
+  for (auto pass = 0; pass < 2; ++pass) {
+    const auto& source = pass == 0 ? image : horizontal;
+    auto& target = pass == 0 ? horizontal : result;
+    for (auto y = 0u; y < height; ++y) {
+      for (auto x = 0u; x < width; ++x) {
+        auto sum = glm::vec3{0.0f};
+        auto weight_sum = 0.0f;
+        for (auto i = 0u; i < kernel.size(); ++i) {
+          auto offset = static_cast<int>(i) - 2;
+          auto sample_x = static_cast<int>(x) + (pass == 0 ? offset : 0);
+          auto sample_y = static_cast<int>(y) + (pass == 1 ? offset : 0);
+          if (sample_x < 0 || sample_y < 0 || sample_x >= static_cast<int>(width) || sample_y >= static_cast<int>(height)) {
+            continue;
+          }
+          sum += source[static_cast<unsigned>(sample_y) * width + static_cast<unsigned>(sample_x)] * kernel[i];
+          weight_sum += kernel[i];
+        }
+        target[y * width + x] = sum / weight_sum;
+      }
+    }
+  }
+  return result;
+}
+
+// RMSE and relative MSE of the linear colors, and a simplified FLIP (Andersson et al. 2020,
+// "FLIP: A Difference Evaluator for Alternating Images"): the HyAB distance between the
+// blurred CIELAB images, mapped to [0, 1] and averaged. FLIP's edge and point terms are left out.
+auto measure_error(const Framebuffer& image, const Framebuffer& reference, const Region& region) -> ImageError {
+  constexpr auto relative_epsilon = 0.01;
+  constexpr auto max_distance = 100.0f;
+
+  auto width = region.width();
+  auto height = region.height();
+  auto image_lab = std::vector<glm::vec3>{};
+  auto reference_lab = std::vector<glm::vec3>{};
+  auto squared_error = 0.0;
+  auto relative_error = 0.0;
+
+  for (auto y = region.y0; y < region.y1; ++y) {
+    for (auto x = region.x0; x < region.x1; ++x) {
+      auto pixel = y * image.width + x;
+      auto color = image.color(pixel);
+      auto expected = reference.color(pixel);
+      for (auto channel = 0; channel < 3; ++channel) {
+        auto difference = static_cast<double>(color[channel] - expected[channel]);
+        squared_error += difference * difference;
+        relative_error += difference * difference / (static_cast<double>(expected[channel] * expected[channel]) + relative_epsilon);
+      }
+      image_lab.push_back(to_lab(color));
+      reference_lab.push_back(to_lab(expected));
+    }
+  }
+
+  image_lab = blur(image_lab, width, height);
+  reference_lab = blur(reference_lab, width, height);
+  auto flip = 0.0;
+  for (auto i = 0uz; i < image_lab.size(); ++i) {
+    auto difference = image_lab[i] - reference_lab[i];
+    auto distance = std::abs(difference.x) + std::sqrt(difference.y * difference.y + difference.z * difference.z);
+    flip += std::pow(std::min(distance / max_distance, 1.0f), 0.7f);
+  }
+
+  auto values = static_cast<double>(image_lab.size()) * 3.0;
+  return ImageError{std::sqrt(squared_error / values), relative_error / values, flip / static_cast<double>(image_lab.size())};
+}
+
+// The reference of the scene, rendered and stored when it is missing. It is rendered with
+// another seed than the timed renders, which would otherwise share its samples. A stored
+// reference is only used when it renders the same image: its seed and number of samples may
+// differ, every other field of its header must match.
+auto get_reference(const std::string& directory, const std::string& name, Scene scene, unsigned samples) -> std::optional<Framebuffer> {
+  auto path = (std::filesystem::path{directory} / (name + ".rtck")).string();
+  scene.options.num_samples = samples;
+  scene.options.seed = ~scene.options.seed;
+  scene.options.time_budget = 0.0f;
+
+  if (std::filesystem::exists(path)) {
+    auto reference = read_checkpoint(path);
+    if (!reference) {
+      return {};
+    }
+    auto options = scene.options;
+    options.num_samples = reference->header.num_samples;
+    auto expected = get_checkpoint_header(options, scene.width, scene.height);
+    expected.seed = reference->header.seed;
+    if (!(reference->header == expected)) {
+      std::cerr << "[ERROR] The reference " << path << " was not rendered with the options of the scene, remove it to render it again\n";
+      return {};
+    }
+    return std::move(reference->framebuffer);
+  }
+
+  std::cout << "Rendering the reference of " << name << " with " << samples << " samples\n";
+  auto reference = render(scene.width, scene.height, scene.options, scene.hittables);
+  auto header = get_checkpoint_header(scene.options, scene.width, scene.height);
+  if (!reference || !write_checkpoint(path, header, *reference)) {
+    return {};
+  }
+  return reference;
+}
+
+auto write_json(const std::string& path, const std::vector<Measurement>& measurements) -> bool {
+  auto file = std::ofstream{path};
+  if (!file) {
+    std::cerr << "[ERROR] Failed to open " << path << "\n";
+    return false;
+  }
+  file << "{\n  \"measurements\": [\n";
+  for (auto i = 0uz; i < measurements.size(); ++i) {
+    const auto& measurement = measurements[i];
+    file << "    {\"scene\": \"" << measurement.scene << "\", \"budget\": " << measurement.budget
+         << ", \"seconds\": " << measurement.seconds << ", \"samples\": " << measurement.samples
+         << ", \"rmse\": " << measurement.error.rmse << ", \"relative_mse\": " << measurement.error.relative_mse
+         << ", \"flip\": " << measurement.error.flip << "}" << (i + 1 < measurements.size() ? "," : "") << "\n";
+  }
+  file << "  ]\n}\n";
+  return static_cast<bool>(file);
+}
+
+auto split(std::string_view text) -> std::vector<std::string> {
+  auto parts = std::vector<std::string>{};
+  while (true) {
+    auto comma = text.find(',');
+    parts.emplace_back(text.substr(0, comma));
+    if (comma == std::string_view::npos) {
+      return parts;
+    }
+    text.remove_prefix(comma + 1);
+  }
+}
+
+auto print_converge_usage() -> void {
+  std::cerr << "Usage: ray-tracer-converge <reference directory> [--scenes a,b] [--budgets 1,2,4]\n"
+            << "                           [--reference-samples n] [--json file] [render options]\n";
+}
+
+auto main(int argc, char* argv[]) -> int {
+  auto args = std::span{argv, static_cast<std::size_t>(argc)};
+  if (args.size() < 2) {
+    print_converge_usage();
+    return 1;
+  }
+
+  auto reference_directory = std::string{args[1]};
+  auto scene_names = std::vector<std::string>{"cornell_box", "cornell_smoke", "mesh", "final_scene"};
+  auto budgets = std::vector<float>{1.0f, 2.0f, 4.0f, 8.0f, 16.0f};
+  auto reference_samples = 4096u;
+  auto json_path = std::string{};
+  // the render options are parsed by parse_command_line, after a program and a scene name
+  auto render_args = std::vector<char*>{args[0], args[0]};
+
+  for (auto i = 2uz; i < args.size(); ++i) {
+    auto arg = std::string_view{args[i]};
+    auto has_value = i + 1 < args.size();
+    if (arg == "--scenes" && has_value) {
+      scene_names = split(args[++i]);
+    }
+    else if (arg == "--budgets" && has_value) {
+      budgets.clear();
+      for (const auto& text : split(args[++i])) {
+        auto budget = parse_number<float>(text);
+        if (!budget || *budget <= 0.0f) {
+          std::cerr << "Invalid time budget " << text << "\n";
+          return 1;
+        }
+        budgets.push_back(*budget);
+      }
+    }
+    else if (arg == "--reference-samples" && has_value) {
+      auto samples = parse_number<unsigned>(args[++i]);
+      if (!samples || *samples == 0) {
+        std::cerr << "Invalid number of reference samples\n";
+        return 1;
+      }
+      reference_samples = *samples;
+    }
+    else if (arg == "--json" && has_value) {
+      json_path = args[++i];
+    }
+    else {
+      render_args.push_back(args[i]);
+    }
+  }
+
+  auto command_line = parse_command_line(render_args);
+  if (!command_line) {
+    print_converge_usage();
+    return 1;
+  }
+  std::filesystem::create_directories(reference_directory);
+
+  auto measurements = std::vector<Measurement>{};
+  for (const auto& name : scene_names) {
+    auto scene = load_scene(name);
+    if (!scene) {
+      return 1;
+    }
+    apply_command_line(*command_line, scene->options);
+    auto reference = get_reference(reference_directory, name, *scene, reference_samples);
+    if (!reference) {
+      return 1;
+    }
+
+    auto region = get_region(scene->options, scene->width, scene->height);
+    for (auto budget : budgets) {
+      // the budget stops the render, the samples of the reference are only a limit
+      auto options = scene->options;
+      options.time_budget = budget;
+      options.num_samples = reference_samples;
+      auto timer = Timer{};
+      auto image = render(scene->width, scene->height, options, scene->hittables);
+      if (!image) {
+        return 1;
+      }
+      auto seconds = timer.elapsed() / 1000.0;
+      auto samples = *std::max_element(image->sample_counts.begin(), image->sample_counts.end());
+      measurements.push_back(Measurement{name, budget, seconds, samples, measure_error(*image, *reference, region)});
+    }
+  }
+
+  std::cout << std::left << std::setw(16) << "scene" << std::right << std::setw(10) << "seconds" << std::setw(10) << "samples"
+            << std::setw(14) << "rmse" << std::setw(14) << "relmse" << std::setw(14) << "flip" << "\n";
+  for (const auto& measurement : measurements) {
+    std::cout << std::left << std::setw(16) << measurement.scene << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << measurement.seconds << std::setw(10) << measurement.samples << std::setprecision(6)
+              << std::setw(14) << measurement.error.rmse << std::setw(14) << measurement.error.relative_mse
+              << std::setw(14) << measurement.error.flip << "\n";
+  }
+
+  if (!json_path.empty() && !write_json(json_path, measurements)) {
+    return 1;
+  }
+  return 0;
+}
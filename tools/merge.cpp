@@ -0,0 +1,80 @@
+// Combines the partial results of a render split between processes into the final image.
+// Usage: ray-tracer-merge <output.ppm> <partial>...
+
+#include "checkpoint.hpp"
+#include "framebuffer.hpp"
+#include "ppm.hpp"
+
+#include <iostream>
+#include <numeric>
+#include <span>
+#include <string>
+#include <vector>
+
+// Partials may only share pixels if they took different samples
+auto overlap(const CheckpointHeader& a, const CheckpointHeader& b) -> bool {
+  auto same_tiles = a.tile_index % std::gcd(a.tile_count, b.tile_count) == b.tile_index % std::gcd(a.tile_count, b.tile_count);
+  auto same_samples = a.sample_begin < b.sample_end && b.sample_begin < a.sample_end;
+  return same_tiles && same_samples;
+}
+
+auto main(int argc, char* argv[]) -> int {
+  auto args = std::span{argv, static_cast<std::size_t>(argc)};
+  if (args.size() < 3) {
+    std::cerr << "Usage: ray-tracer-merge <output.ppm> <partial>...\n";
+    return 1;
+  }
+
+  auto headers = std::vector<CheckpointHeader>{};
+  auto merged = Framebuffer{};
+
+  for (auto i = 2uz; i < args.size(); ++i) {
+    auto partial = read_checkpoint(args[i]);
+    if (!partial) {
+      return 1;
+    }
+
+    if (headers.empty()) {
+      merged = Framebuffer{partial->header.width, partial->header.height};
+    }
+    else if (!same_render(headers.front(), partial->header)) {
+      std::cerr << "[ERROR] " << args[i] << " is a part of a different render than " << args[2] << '\n';
+      return 1;
+    }
+
+    for (auto j = 0uz; j < headers.size(); ++j) {
+      if (overlap(headers[j], partial->header)) {
+        std::cerr << "[ERROR] " << args[i] << " has samples that " << args[j + 2] << " also has\n";
+        return 1;
+      }
+    }
+    headers.push_back(partial->header);
+
+    // the sums and counts add up, so every partial weighs as much as the samples it took
+    for (auto pixel = 0uz; pixel < merged.accumulation.size(); ++pixel) {
+      merged.accumulation[pixel] += partial->framebuffer.accumulation[pixel];
+      merged.sample_counts[pixel] += partial->framebuffer.sample_counts[pixel];
+    }
+  }
+
+  // only the crop window is rendered and written, as by a single process
+  auto crop = get_crop(headers.front());
+  auto missing = 0uz;
+  for (auto y = crop.y0; y < crop.y1; ++y) {
+    for (auto x = crop.x0; x < crop.x1; ++x) {
+      missing += merged.sample_counts[y * merged.width + x] < headers.front().num_samples ? 1u : 0u;
+    }
+  }
+  if (missing > 0) {
+    std::cerr << "Warning: " << missing << " pixels have less than " << headers.front().num_samples << " samples\n";
+  }
+
+  auto ppm = Ppm{args[1], crop.width(), crop.height()};
+  for (auto y = crop.y0; y < crop.y1; ++y) {
+    for (auto x = crop.x0; x < crop.x1; ++x) {
+      ppm.write_color(merged.color(y * merged.width + x));
+    }
+  }
+
+  return 0;
+}